@@ -0,0 +1,474 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "bitbase.h"
+
+using namespace NerdChess::bitb;
+
+#define BITBASE_VERSION 1
+
+// States used while building a table
+#define STATE_UNKNOWN 0
+#define STATE_WIN 1
+#define STATE_LOSS 2
+#define STATE_DRAW 3
+#define STATE_INVALID 4
+
+std::vector<struct NerdChess::bitbase::table> NerdChess::bitbase::tables;
+
+static const std::string piece_order = "QRBNP"; // Order of the pieces of one side in a table name
+static const int piece_worth[] = {1, 3, 3, 5, 9, 0}; // Only used to decide which side is the strong one
+
+static int char_to_type(char c) {
+    switch(c) {
+        case 'P': return PAWN;
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+    }
+    return KING;
+}
+
+// 3 bits per piece type and color, kings are not counted
+static uint32_t material_key(const int counts[12]) {
+    uint32_t key = 0;
+    for(int i = 0, shift = 0; i < 12; ++i) {
+        if(i == KING || i == KING+_BLACK)
+            continue;
+        key |= (uint32_t)std::min(counts[i], 7) << shift;
+        shift += 3;
+    }
+    return key;
+}
+
+static uint32_t material_key(const struct NerdChess::board::position& pos) {
+    int counts[12];
+    for(int i = 0; i < 12; ++i)
+        counts[i] = popcount(pos.pieces[i]);
+    return material_key(counts);
+}
+
+// Positions in which neither side can ever mate (KK, KNK, KBK)
+static bool insufficient(const struct NerdChess::board::position& pos) {
+    const bitboard others = pos.pieces[PAWN] | pos.pieces[ROOK] | pos.pieces[QUEEN] | pos.pieces[PAWN+_BLACK] | pos.pieces[ROOK+_BLACK] | pos.pieces[QUEEN+_BLACK];
+    const bitboard minors = pos.pieces[KNIGHT] | pos.pieces[BISHOP] | pos.pieces[KNIGHT+_BLACK] | pos.pieces[BISHOP+_BLACK];
+    return !others && popcount(minors) <= 1;
+}
+
+static int side_worth(const std::string& side) {
+    int worth = 0;
+    for(size_t i = 1; i < side.size(); ++i)
+        worth += piece_worth[char_to_type(side[i])];
+    return worth;
+}
+
+// Sorts the pieces of both sides and puts the stronger side first ("KRKQ" -> "KQKR")
+std::string NerdChess::bitbase::normalize(const std::string& name) {
+    const size_t second_king = name.find('K', 1);
+    if(name.empty() || name[0] != 'K' || second_king == std::string::npos)
+        return "";
+    std::string sides[2] = {name.substr(0, second_king), name.substr(second_king)};
+    for(int i = 0; i < 2; ++i) {
+        std::sort(sides[i].begin() + 1, sides[i].end(), [](char a, char b) { return piece_order.find(a) < piece_order.find(b); });
+        for(size_t j = 1; j < sides[i].size(); ++j)
+            if(piece_order.find(sides[i][j]) == std::string::npos)
+                return "";
+    }
+    if(side_worth(sides[1]) > side_worth(sides[0]) || (side_worth(sides[1]) == side_worth(sides[0]) && sides[1] > sides[0]))
+        std::swap(sides[0], sides[1]);
+    return sides[0] + sides[1];
+}
+
+static bool trivial_draw(const std::string& name) {
+    return name == "KK" || name == "KNK" || name == "KBK";
+}
+
+static struct NerdChess::bitbase::table make_table(const std::string& name) {
+    struct NerdChess::bitbase::table t;
+    const size_t second_king = name.find('K', 1);
+    int counts[12] = {0};
+    int flipped_counts[12] = {0};
+    t.name = name;
+    t.count = 0;
+    t.pawns = false;
+    t.types[t.count] = KING;
+    t.colors[t.count++] = WHITE;
+    t.types[t.count] = KING;
+    t.colors[t.count++] = BLACK;
+    for(size_t i = 1; i < name.size(); ++i) {
+        if(i == second_king)
+            continue;
+        const bool color = i > second_king;
+        t.types[t.count] = char_to_type(name[i]);
+        t.colors[t.count++] = color;
+        counts[t.types[t.count-1] + (color ? _BLACK : 0)]++;
+        flipped_counts[t.types[t.count-1] + (color ? 0 : _BLACK)]++;
+        if(name[i] == 'P')
+            t.pawns = true;
+    }
+    t.key = material_key(counts);
+    t.flipped_key = material_key(flipped_counts);
+    t.size = 2ULL * (t.pawns ? 32 : 16);
+    for(int i = 1; i < t.count; ++i)
+        t.size *= 64;
+    return t;
+}
+
+// Materials reachable from a table by one capture or promotion
+static std::vector<std::string> dependencies(const std::string& name) {
+    std::vector<std::string> deps;
+    for(size_t i = 1; i < name.size(); ++i) {
+        if(name[i] == 'K')
+            continue;
+        deps.push_back(NerdChess::bitbase::normalize(name.substr(0, i) + name.substr(i + 1)));
+        if(name[i] == 'P')
+            for(char promotion : std::string("QRBN"))
+                deps.push_back(NerdChess::bitbase::normalize(name.substr(0, i) + promotion + name.substr(i + 1)));
+    }
+    return deps;
+}
+
+static inline int king_squares(const struct NerdChess::bitbase::table& t) {
+    return t.pawns ? 32 : 16;
+}
+
+// Turns an index back into piece squares. Returns false for impossible positions and for the
+// duplicates created by two identical pieces (only the ascending order of their squares is used).
+static bool decode(const struct NerdChess::bitbase::table& t, uint64_t index, int sq[], bool& stm) {
+    for(int i = t.count - 1; i > 0; --i) {
+        sq[i] = index % 64;
+        index /= 64;
+    }
+    const int king = index % king_squares(t);
+    stm = index / king_squares(t);
+    sq[0] = t.pawns ? (king / 4) * 8 + king % 4 : (4 + king / 4) * 8 + king % 4;
+
+    bitboard occupied = 0ULL;
+    for(int i = 0; i < t.count; ++i) {
+        if(get_bit(occupied, sq[i]))
+            return false;
+        set_bit(occupied, sq[i]);
+        if(t.types[i] == PAWN && (GET_RANK(sq[i]) == 0 || GET_RANK(sq[i]) == 7))
+            return false;
+        if(i > 1 && t.types[i] == t.types[i-1] && t.colors[i] == t.colors[i-1] && sq[i] < sq[i-1])
+            return false;
+    }
+    return !get_bit(NerdChess::movegen::king_attacks[sq[0]], sq[1]);
+}
+
+// Index of the piece squares (strong side as white) after mirroring the strong king into its area
+static uint64_t index_of(const struct NerdChess::bitbase::table& t, const int squares[], bool stm) {
+    int sq[BITBASE_MAX_PIECES] = {0};
+    int flip = 0;
+    if(GET_FILE(squares[0]) > 3)
+        flip ^= 7;
+    if(!t.pawns && GET_RANK(squares[0]) < 4)
+        flip ^= 56;
+    for(int i = 0; i < t.count; ++i)
+        sq[i] = squares[i] ^ flip;
+    for(int i = 2; i < t.count; ++i)
+        if(t.types[i] == t.types[i-1] && t.colors[i] == t.colors[i-1] && sq[i] < sq[i-1])
+            std::swap(sq[i], sq[i-1]);
+
+    const int file = GET_FILE(sq[0]);
+    const int rank = GET_RANK(sq[0]);
+    uint64_t index = (uint64_t)stm * king_squares(t) + (t.pawns ? rank * 4 + file : (rank - 4) * 4 + file);
+    for(int i = 1; i < t.count; ++i)
+        index = index * 64 + sq[i];
+    return index;
+}
+
+static struct NerdChess::board::position to_position(const struct NerdChess::bitbase::table& t, const int sq[]) {
+    struct NerdChess::board::position pos = NerdChess::board::get_empty_position();
+    for(int i = 0; i < t.count; ++i)
+        set_bit(pos.pieces[t.types[i] + (t.colors[i] ? _BLACK : 0)], sq[i]);
+    return pos;
+}
+
+static inline int get_value(const struct NerdChess::bitbase::table& t, uint64_t index) {
+    return (t.data[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+// Every position is classified by looking at its moves: moves which stay in the table are counted,
+// captures and promotions are resolved with the (already built) smaller tables.
+static void classify(const struct NerdChess::bitbase::table& t, uint64_t begin, uint64_t end, std::atomic<uint8_t>* state, std::atomic<uint8_t>* moves_left, std::vector<uint64_t>& decided) {
+    int sq[BITBASE_MAX_PIECES];
+    bool stm;
+    for(uint64_t index = begin; index < end; ++index) {
+        if(!decode(t, index, sq, stm)) {
+            state[index] = STATE_INVALID;
+            continue;
+        }
+        const struct NerdChess::board::position pos = to_position(t, sq);
+        if(NerdChess::movegen::in_check(pos, !stm)) {
+            state[index] = STATE_INVALID;
+            continue;
+        }
+
+        struct NerdChess::movegen::move_list list;
+        NerdChess::movegen::generate(pos, stm, list);
+        if(list.size == 0) {
+            state[index] = NerdChess::movegen::in_check(pos, stm) ? STATE_LOSS : STATE_DRAW;
+            if(state[index] == STATE_LOSS)
+                decided.push_back(index);
+            continue;
+        }
+
+        int count = 0;
+        bool win = false;
+        for(int i = 0; i < list.size && !win; ++i) {
+            struct NerdChess::board::position child = pos;
+            NerdChess::movegen::make_move(child, list.moves[i]);
+            if(material_key(child) == t.key) {
+                count++;
+                continue;
+            }
+            const int result = NerdChess::bitbase::probe(child, !stm);
+            if(result == BITBASE_LOSS)
+                win = true;
+            else if(result != BITBASE_WIN)
+                count++; // A drawn exit is never taken away, so this position can't be lost anymore
+        }
+
+        moves_left[index] = std::min(count, 255);
+        if(win || count == 0) {
+            state[index] = win ? STATE_WIN : STATE_LOSS;
+            decided.push_back(index);
+        } else {
+            state[index] = STATE_UNKNOWN;
+        }
+    }
+}
+
+// Goes backwards from positions whose result just became known: a predecessor of a lost position is won,
+// a predecessor is lost once all of its moves lead to won positions.
+static void propagate(const struct NerdChess::bitbase::table& t, const std::vector<uint64_t>& frontier, size_t begin, size_t end, std::atomic<uint8_t>* state, std::atomic<uint8_t>* moves_left, std::vector<uint64_t>& decided) {
+    int sq[BITBASE_MAX_PIECES];
+    int pred[BITBASE_MAX_PIECES];
+    bool stm;
+    for(size_t f = begin; f < end; ++f) {
+        const uint64_t index = frontier[f];
+        const int value = state[index];
+        decode(t, index, sq, stm);
+        const bool mover = !stm;
+
+        bitboard occupied = 0ULL;
+        for(int i = 0; i < t.count; ++i)
+            set_bit(occupied, sq[i]);
+
+        for(int i = 0; i < t.count; ++i) {
+            if(t.colors[i] != mover)
+                continue;
+
+            bitboard from = 0ULL;
+            switch(t.types[i]) {
+                case PAWN: {
+                    const int back = mover == WHITE ? 8 : -8;
+                    const int double_rank = mover == WHITE ? 4 : 3;
+                    if(!get_bit(occupied, sq[i] + back)) {
+                        set_bit(from, sq[i] + back);
+                        if(GET_RANK(sq[i]) == double_rank && !get_bit(occupied, sq[i] + 2*back))
+                            set_bit(from, sq[i] + 2*back);
+                    }
+                    break;
+                }
+                case KNIGHT: from = NerdChess::movegen::knight_attacks[sq[i]]; break;
+                case BISHOP: from = NerdChess::movegen::bishop_attacks(sq[i], occupied); break;
+                case ROOK: from = NerdChess::movegen::rook_attacks(sq[i], occupied); break;
+                case QUEEN: from = NerdChess::movegen::bishop_attacks(sq[i], occupied) | NerdChess::movegen::rook_attacks(sq[i], occupied); break;
+                case KING: from = NerdChess::movegen::king_attacks[sq[i]]; break;
+            }
+            from &= ~occupied;
+
+            while(from) {
+                std::copy(sq, sq + t.count, pred);
+                pred[i] = pop_lsb(from);
+                if(t.types[i] == PAWN && (GET_RANK(pred[i]) == 0 || GET_RANK(pred[i]) == 7))
+                    continue;
+                const uint64_t p = index_of(t, pred, mover);
+                if(state[p] != STATE_UNKNOWN)
+                    continue;
+
+                uint8_t expected = STATE_UNKNOWN;
+                if(value == STATE_LOSS) {
+                    if(state[p].compare_exchange_strong(expected, STATE_WIN))
+                        decided.push_back(p);
+                } else if(moves_left[p].fetch_sub(1) == 1) {
+                    if(state[p].compare_exchange_strong(expected, STATE_LOSS))
+                        decided.push_back(p);
+                }
+            }
+        }
+    }
+}
+
+static void build(struct NerdChess::bitbase::table& t, int threads) {
+    std::unique_ptr<std::atomic<uint8_t>[]> state(new std::atomic<uint8_t>[t.size]);
+    std::unique_ptr<std::atomic<uint8_t>[]> moves_left(new std::atomic<uint8_t>[t.size]);
+    std::vector<std::vector<uint64_t>> decided(threads);
+    std::vector<std::thread> workers;
+
+    for(int i = 0; i < threads; ++i) {
+        const uint64_t begin = t.size * i / threads;
+        const uint64_t end = t.size * (i + 1) / threads;
+        workers.emplace_back(classify, std::cref(t), begin, end, state.get(), moves_left.get(), std::ref(decided[i]));
+    }
+    for(std::thread& worker : workers)
+        worker.join();
+
+    std::vector<uint64_t> frontier;
+    for(std::vector<uint64_t>& d : decided) {
+        frontier.insert(frontier.end(), d.begin(), d.end());
+        d.clear();
+    }
+
+    while(!frontier.empty()) {
+        workers.clear();
+        for(int i = 0; i < threads; ++i) {
+            const size_t begin = frontier.size() * i / threads;
+            const size_t end = frontier.size() * (i + 1) / threads;
+            workers.emplace_back(propagate, std::cref(t), std::cref(frontier), begin, end, state.get(), moves_left.get(), std::ref(decided[i]));
+        }
+        for(std::thread& worker : workers)
+            worker.join();
+
+        frontier.clear();
+        for(std::vector<uint64_t>& d : decided) {
+            frontier.insert(frontier.end(), d.begin(), d.end());
+            d.clear();
+        }
+    }
+
+    // Whatever is still unknown can't be won by either side
+    t.data.assign((t.size + 3) / 4, 0);
+    for(uint64_t index = 0; index < t.size; ++index) {
+        const int value = state[index] == STATE_WIN ? BITBASE_WIN : (state[index] == STATE_LOSS ? BITBASE_LOSS : BITBASE_DRAW);
+        t.data[index >> 2] |= value << ((index & 3) * 2);
+    }
+}
+
+static void load_cache(const std::string& cache_file, std::vector<struct NerdChess::bitbase::table>& cached) {
+    std::ifstream file(cache_file, std::ios::binary);
+    char magic[4];
+    uint32_t version, count;
+    if(!file.read(magic, 4) || std::string(magic, 4) != "NCBB")
+        return;
+    if(!file.read((char*)&version, sizeof(version)) || version != BITBASE_VERSION || !file.read((char*)&count, sizeof(count)))
+        return;
+    for(uint32_t i = 0; i < count; ++i) {
+        uint8_t length;
+        uint64_t size;
+        std::string name;
+        if(!file.read((char*)&length, 1))
+            return;
+        name.resize(length);
+        if(!file.read(&name[0], length) || !file.read((char*)&size, sizeof(size)))
+            return;
+        struct NerdChess::bitbase::table t = make_table(name);
+        if(t.size != size)
+            return;
+        t.data.resize((t.size + 3) / 4);
+        if(!file.read((char*)t.data.data(), t.data.size()))
+            return;
+        cached.push_back(t);
+    }
+}
+
+static void save_cache(const std::string& cache_file) {
+    std::ofstream file(cache_file, std::ios::binary | std::ios::trunc);
+    const uint32_t version = BITBASE_VERSION;
+    const uint32_t count = NerdChess::bitbase::tables.size();
+    file.write("NCBB", 4);
+    file.write((const char*)&version, sizeof(version));
+    file.write((const char*)&count, sizeof(count));
+    for(const struct NerdChess::bitbase::table& t : NerdChess::bitbase::tables) {
+        const uint8_t length = t.name.size();
+        file.write((const char*)&length, 1);
+        file.write(t.name.data(), length);
+        file.write((const char*)&t.size, sizeof(t.size));
+        file.write((const char*)t.data.data(), t.data.size());
+    }
+}
+
+static bool have_table(const std::string& name) {
+    for(const struct NerdChess::bitbase::table& t : NerdChess::bitbase::tables)
+        if(t.name == name)
+            return true;
+    return false;
+}
+
+// Adds a table after all the tables it depends on
+static void add_table(const std::string& name, std::vector<struct NerdChess::bitbase::table>& cached, int threads, bool& built) {
+    if(name.empty() || trivial_draw(name) || have_table(name))
+        return;
+    for(const std::string& dep : dependencies(name))
+        add_table(dep, cached, threads, built);
+
+    for(struct NerdChess::bitbase::table& t : cached) {
+        if(t.name == name) {
+            NerdChess::bitbase::tables.push_back(t);
+            return;
+        }
+    }
+    struct NerdChess::bitbase::table t = make_table(name);
+    build(t, threads);
+    NerdChess::bitbase::tables.push_back(t);
+    built = true;
+}
+
+void NerdChess::bitbase::init(const std::vector<std::string>& names, int threads, const std::string& cache_file) {
+    std::vector<struct table> cached;
+    bool built = false;
+    if(threads < 1)
+        threads = 1;
+    if(!cache_file.empty())
+        load_cache(cache_file, cached);
+
+    for(const std::string& name : names) {
+        const std::string normalized = normalize(name);
+        int pieces = normalized.size();
+        if(normalized.empty() || pieces > BITBASE_MAX_PIECES) {
+            std::cerr << "Unsupported bitbase \"" << name << "\"\n";
+            continue;
+        }
+        add_table(normalized, cached, threads, built);
+    }
+
+    // Keep the tables which were cached but not asked for this time
+    for(struct table& t : cached)
+        if(!have_table(t.name))
+            tables.push_back(t);
+    if(built && !cache_file.empty())
+        save_cache(cache_file);
+}
+
+int NerdChess::bitbase::probe(const struct board::position& pos, bool side_to_move) {
+    const bitboard occupied = board::map_pieces(pos);
+    if(popcount(occupied) > BITBASE_MAX_PIECES)
+        return BITBASE_UNKNOWN;
+    if(insufficient(pos))
+        return BITBASE_DRAW;
+
+    const uint32_t key = material_key(pos);
+    for(const struct table& t : tables) {
+        if(key != t.key && key != t.flipped_key)
+            continue;
+
+        // With the strong side playing black the board is flipped vertically and the colors are swapped
+        const bool flipped = key != t.key;
+        int sq[BITBASE_MAX_PIECES];
+        bitboard pieces[12];
+        for(int i = 0; i < 12; ++i)
+            pieces[i] = pos.pieces[i];
+        for(int i = 0; i < t.count; ++i) {
+            bitboard& bb = pieces[t.types[i] + ((t.colors[i] != flipped) ? _BLACK : 0)];
+            sq[i] = pop_lsb(bb) ^ (flipped ? 56 : 0);
+        }
+        return get_value(t, index_of(t, sq, side_to_move != flipped));
+    }
+    return BITBASE_UNKNOWN;
+}
@@ -0,0 +1,44 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "movegen.h"
+
+// Probe results (from the point of view of the side to move)
+#define BITBASE_UNKNOWN -1 // No table for this material
+#define BITBASE_DRAW 0
+#define BITBASE_WIN 1
+#define BITBASE_LOSS 2
+
+#define BITBASE_MAX_PIECES 4
+
+namespace NerdChess {
+namespace bitbase {
+// Win/draw/loss table of one material combination, e.g. "KQKR". The first side is called the strong side
+// and is stored as white; positions with the colors swapped are probed by flipping the board. Every position
+// takes 2 bits. The strong king is kept in one quadrant (pawnless) or on files a-d (with pawns) by mirroring.
+struct table {
+    std::string name;
+    int count; // Number of pieces including both kings
+    int types[BITBASE_MAX_PIECES]; // Strong king, weak king, strong pieces, weak pieces
+    bool colors[BITBASE_MAX_PIECES];
+    bool pawns;
+    uint64_t size; // Number of positions
+    uint32_t key; // Material key with the strong side as white
+    uint32_t flipped_key; // Material key with the strong side as black
+    std::vector<uint8_t> data;
+};
+
+extern std::vector<struct table> tables;
+
+// Builds (or loads from cache_file, if it is not empty) the given tables and every table they depend on.
+// Tables which had to be built are written back to cache_file.
+void init(const std::vector<std::string>& names, int threads, const std::string& cache_file);
+int probe(const struct board::position& pos, bool side_to_move);
+std::string normalize(const std::string& name);
+} // namespace bitbase
+} // namespace NerdChess
+
+#endif
@@ -2,6 +2,10 @@
 #define BITBOARD_H
 
 #include <iostream>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 #define SQUARE(x)((x)*(x))
 
@@ -30,6 +34,48 @@ inline void clear_bit(bitboard& bb, int pos)
     bb &= ~(1ULL << pos);
 }
 
+// Number of set bits
+inline int popcount(bitboard bb)
+{
+#if defined(_MSC_VER)
+    return (int)__popcnt64(bb);
+#else
+    return __builtin_popcountll(bb);
+#endif
+}
+
+// Index of the lowest set bit (bb must not be empty)
+inline int lsb(bitboard bb)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, bb);
+    return (int)i;
+#else
+    return __builtin_ctzll(bb);
+#endif
+}
+
+// Index of the highest set bit (bb must not be empty)
+inline int msb(bitboard bb)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanReverse64(&i, bb);
+    return (int)i;
+#else
+    return 63 - __builtin_clzll(bb);
+#endif
+}
+
+// Clears the lowest set bit and returns its index
+inline int pop_lsb(bitboard& bb)
+{
+    const int i = lsb(bb);
+    bb &= bb - 1;
+    return i;
+}
+
 void move_bit(bitboard& bb, int from, int to);
 void print_bitboard(bitboard bb);
 } // namespace bitb
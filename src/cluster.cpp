@@ -0,0 +1,450 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "cluster.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // A worker whose coordinator went away then dies of SIGPIPE, which is fine too
+#endif
+
+#define READ_CHUNK 4096
+
+// A socket and what was read from it past the last complete line
+struct connection {
+    int fd;
+    std::string buffer;
+};
+
+// The coordinator's view of a worker
+struct worker_state {
+    struct connection conn;
+    bool alive;
+    bool busy;
+    uint32_t job; // Id of the job it is searching
+    int root_index; // Its root move
+    bool sent; // Has had a job in this search
+};
+
+// Worker processes started by the coordinator shouldn't inherit its sockets
+static int close_on_exec(int fd) {
+    if(fd >= 0)
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// Opens a socket of the right family for "unix:/path" or "host:port" and fills in the address
+static int make_socket(const std::string& address, struct sockaddr_storage& addr, socklen_t& length) {
+    std::memset(&addr, 0, sizeof(addr));
+    if(address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un* un = (struct sockaddr_un*)&addr;
+        const std::string path = address.substr(5);
+        if(path.empty() || path.size() >= sizeof(un->sun_path))
+            return -1;
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(struct sockaddr_un);
+        return close_on_exec(socket(AF_UNIX, SOCK_STREAM, 0));
+    }
+
+    const size_t colon = address.rfind(':');
+    if(colon == std::string::npos)
+        return -1;
+    const std::string host = colon > 0 ? address.substr(0, colon) : "127.0.0.1";
+    struct addrinfo hints, *found = nullptr;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.c_str(), address.c_str() + colon + 1, &hints, &found) != 0 || !found)
+        return -1;
+    std::memcpy(&addr, found->ai_addr, found->ai_addrlen);
+    length = found->ai_addrlen;
+    const int fd = close_on_exec(socket(found->ai_family, SOCK_STREAM, 0));
+    freeaddrinfo(found);
+    return fd;
+}
+
+// The messages are tiny and every one is waited for, Nagle's algorithm would only add latency
+static void set_no_delay(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on Unix domain sockets
+}
+
+static bool send_line(int fd, const std::string& line) {
+    const std::string data = line + "\n";
+    size_t sent = 0;
+    while(sent < data.size()) {
+        const ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Takes the next complete line out of the buffer
+static bool next_line(struct connection& conn, std::string& line) {
+    const size_t end = conn.buffer.find('\n');
+    if(end == std::string::npos)
+        return false;
+    line = conn.buffer.substr(0, end);
+    conn.buffer.erase(0, end + 1);
+    return true;
+}
+
+// One read, false once the other side closed the connection
+static bool receive(struct connection& conn) {
+    char chunk[READ_CHUNK];
+    ssize_t n;
+    do
+        n = recv(conn.fd, chunk, sizeof(chunk), 0);
+    while(n < 0 && errno == EINTR);
+    if(n <= 0)
+        return false;
+    conn.buffer.append(chunk, n);
+    return true;
+}
+
+static std::string position_to_str(const struct NerdChess::board::position& pos) {
+    std::ostringstream str;
+    str << (int)pos.side << " " << (int)pos.castling << " " << (int)pos.en_pessant << " " << (int)pos.halfmove_clock;
+    for(NerdChess::bitb::bitboard bb : pos.pieces)
+        str << " " << bb;
+    return str.str();
+}
+
+static bool position_from_str(std::istream& in, struct NerdChess::board::position& pos) {
+    int side, castling, en_pessant, halfmove_clock;
+    pos = NerdChess::board::get_empty_position();
+    if(!(in >> side >> castling >> en_pessant >> halfmove_clock))
+        return false;
+    for(NerdChess::bitb::bitboard& bb : pos.pieces) {
+        if(!(in >> bb))
+            return false;
+    }
+    pos.side = side;
+    pos.castling = castling;
+    pos.en_pessant = en_pessant;
+    pos.halfmove_clock = halfmove_clock;
+    pos.key = NerdChess::board::compute_key(pos);
+    return true;
+}
+
+int NerdChess::engine::cluster::listen_on(const std::string& address) {
+    struct sockaddr_storage addr;
+    socklen_t length = 0;
+    const int fd = make_socket(address, addr, length);
+    if(fd < 0)
+        return -1;
+    if(addr.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un*)&addr)->sun_path); // Left over from an earlier run
+    } else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if(bind(fd, (struct sockaddr*)&addr, length) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int NerdChess::engine::cluster::accept_worker(int listener, int timeout_ms) {
+    struct pollfd p = {listener, POLLIN, 0};
+    if(poll(&p, 1, timeout_ms) <= 0)
+        return -1;
+    const int fd = close_on_exec(accept(listener, nullptr, nullptr));
+    if(fd >= 0)
+        set_no_delay(fd);
+    return fd;
+}
+
+int NerdChess::engine::cluster::connect_to(const std::string& address, int timeout_ms) {
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while(true) {
+        struct sockaddr_storage addr;
+        socklen_t length = 0;
+        const int fd = make_socket(address, addr, length);
+        if(fd < 0)
+            return -1;
+        if(connect(fd, (struct sockaddr*)&addr, length) == 0) {
+            set_no_delay(fd);
+            return fd;
+        }
+        close(fd);
+        if(std::chrono::steady_clock::now() >= deadline)
+            return -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(CLUSTER_POLL_MS));
+    }
+}
+
+void NerdChess::engine::cluster::close_socket(int fd) {
+    if(fd >= 0)
+        close(fd);
+}
+
+// The job runs on its own thread so that this one can still read a stop for it. Only the job thread writes.
+void NerdChess::engine::cluster::run_worker(int fd, const struct config& cfg) {
+    struct connection conn = {fd, ""};
+    std::atomic<bool> stop(false);
+    std::atomic<uint32_t> running(0);
+    std::thread job;
+    std::string line;
+
+    while(next_line(conn, line) || receive(conn)) {
+        if(line.empty())
+            continue;
+        std::istringstream in(line);
+        line.clear();
+        std::string type;
+        uint32_t id = 0;
+        in >> type >> id;
+        if(type == "stop") {
+            if(id == running)
+                stop = true;
+            continue;
+        }
+        if(type != "job") {
+            std::cerr << "Unknown message " << type << "\n";
+            continue;
+        }
+
+        int fresh, depth, alpha, beta, keys;
+        struct board::position pos;
+        std::vector<uint64_t> history;
+        if(!(in >> fresh >> depth >> alpha >> beta) || !position_from_str(in, pos) || !(in >> keys)) {
+            std::cerr << "Invalid job " << id << "\n";
+            continue;
+        }
+        history.resize(std::max(0, std::min(keys, MAX_GAME_KEYS)));
+        for(uint64_t& key : history)
+            in >> key;
+
+        if(job.joinable()) {
+            stop = true;
+            job.join();
+        }
+        // Once per search, the table keeps the subtrees of this worker's moves from one depth to the next
+        if(fresh && cfg.use_hash && cfg.hash)
+            cfg.hash->new_search();
+        stop = false;
+        running = id;
+        job = std::thread([fd, id, depth, alpha, beta, pos, history, &cfg, &stop]() {
+            struct search_control control;
+            control.stop = &stop;
+            struct search_info info;
+            search_window(pos, pos.side, depth, alpha, beta, cfg, &info, &control, &history);
+            std::ostringstream done;
+            done << "done " << id << " " << info.depth << " " << info.score << " " << info.nodes;
+            for(movegen::move m : info.pv)
+                done << " " << m;
+            send_line(fd, done.str());
+        });
+    }
+
+    stop = true;
+    if(job.joinable())
+        job.join();
+}
+
+// Iterative deepening like engine::think, with every depth split up by root move (see cluster.h)
+struct NerdChess::engine::engine_eval NerdChess::engine::cluster::think(const std::vector<int>& workers, const struct board::position& root, bool side, const struct search_limits& limits, struct search_info* info, const struct search_control* control, const std::vector<uint64_t>* history) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point deadline = start + std::chrono::milliseconds(limits.time_ms);
+    const bool maximizing = (side == WHITE);
+    struct engine_eval best = {0, {-1, -1}, NO_MOVE};
+    struct search_info progress = {0, 0, {}, 0, 0, {}};
+    struct board::position pos = root;
+    pos.side = side;
+    pos.key = board::compute_key(pos);
+
+    std::vector<struct worker_state> state;
+    for(int fd : workers)
+        state.push_back({{fd, ""}, true, false, 0, -1, false});
+
+    // The children see the root as the last game position
+    std::ostringstream game;
+    {
+        std::vector<uint64_t> keys;
+        if(history)
+            keys.assign(history->end() - std::min<size_t>(history->size(), MAX_GAME_KEYS - 1), history->end());
+        keys.push_back(pos.key);
+        game << keys.size();
+        for(uint64_t key : keys)
+            game << " " << key;
+    }
+
+    struct movegen::move_list moves;
+    movegen::generate(pos, side, moves);
+    if(moves.size > 0) {
+        best.move = moves.moves[0];
+        best.best_move[0] = movegen::move_from(best.move);
+        best.best_move[1] = movegen::move_to(best.move);
+    }
+    std::vector<movegen::move> root_moves(moves.moves, moves.moves + moves.size);
+    std::vector<int> last_worker(root_moves.size(), -1); // Which worker searched each move at the previous depth
+    uint32_t next_job = 0;
+    bool stopped = false;
+
+    for(int depth = 1; depth <= limits.depth && moves.size > 0 && !stopped; ++depth) {
+        std::vector<int> queue; // Root moves still to be handed out, best first
+        for(size_t i = 0; i < root_moves.size(); ++i)
+            queue.push_back(i);
+        std::vector<int> searched_by(root_moves.size(), -1);
+        bool have_best = false; // The first move is back, which gives the others their bound
+        int best_score = 0;
+        int best_index = -1;
+        std::vector<movegen::move> best_pv;
+        int outstanding = 0;
+        bool stopping = false;
+
+        while(!queue.empty() || outstanding > 0) {
+            // Hand out moves to the free workers, a worker's own moves from last time first
+            for(size_t w = 0; w < state.size() && !stopping; ++w) {
+                struct worker_state& worker = state[w];
+                if(!worker.alive || worker.busy || queue.empty() || (!have_best && outstanding > 0))
+                    continue;
+                std::vector<int>::iterator pick = queue.begin();
+                if(have_best) {
+                    std::vector<int>::iterator own = std::find_if(queue.begin(), queue.end(), [&](int i) { return last_worker[i] == (int)w; });
+                    if(own != queue.end())
+                        pick = own;
+                }
+                const int index = *pick;
+                const int alpha = have_best && maximizing ? best_score : -INT_MAX;
+                const int beta = have_best && !maximizing ? best_score : INT_MAX;
+                struct board::position child = pos;
+                movegen::make_move(child, root_moves[index]);
+                child.side = !side;
+                std::ostringstream job;
+                job << "job " << ++next_job << " " << !worker.sent << " " << depth - 1 << " " << alpha << " " << beta << " " << position_to_str(child) << " " << game.str();
+                if(!send_line(worker.conn.fd, job.str())) {
+                    worker.alive = false;
+                    continue;
+                }
+                queue.erase(pick);
+                worker.busy = true;
+                worker.sent = true;
+                worker.job = next_job;
+                worker.root_index = index;
+                searched_by[index] = w;
+                outstanding++;
+            }
+
+            std::vector<struct pollfd> polled;
+            std::vector<size_t> polled_worker;
+            for(size_t w = 0; w < state.size(); ++w) {
+                if(state[w].alive) {
+                    polled.push_back({state[w].conn.fd, POLLIN, 0});
+                    polled_worker.push_back(w);
+                }
+            }
+            if(polled.empty()) {
+                std::cerr << "No workers left\n";
+                stopped = true;
+                break;
+            }
+            poll(polled.data(), polled.size(), CLUSTER_POLL_MS);
+
+            for(size_t p = 0; p < polled.size(); ++p) {
+                struct worker_state& worker = state[polled_worker[p]];
+                if(polled[p].revents == 0)
+                    continue;
+                bool open = receive(worker.conn);
+                std::string line;
+                while(next_line(worker.conn, line)) {
+                    std::istringstream in(line);
+                    std::string type;
+                    uint32_t id;
+                    int done_depth, score;
+                    uint64_t nodes;
+                    if(!(in >> type >> id >> done_depth >> score >> nodes) || type != "done" || !worker.busy || id != worker.job)
+                        continue;
+                    worker.busy = false;
+                    outstanding--;
+                    progress.nodes += nodes;
+                    if(done_depth != depth - 1)
+                        continue; // Stopped before it finished
+                    const int index = worker.root_index;
+                    last_worker[index] = searched_by[index];
+                    if(have_best && (maximizing ? score <= best_score : score >= best_score))
+                        continue;
+                    have_best = true;
+                    best_score = score;
+                    best_index = index;
+                    best_pv.assign(1, root_moves[index]);
+                    int m;
+                    while(in >> m)
+                        best_pv.push_back(m);
+                }
+                if(!open) {
+                    // Whatever it was searching goes to someone else
+                    worker.alive = false;
+                    if(worker.busy) {
+                        worker.busy = false;
+                        outstanding--;
+                        if(!stopping)
+                            queue.insert(have_best ? queue.end() : queue.begin(), worker.root_index);
+                    }
+                }
+            }
+
+            if(!stopping && ((limits.time_ms > 0 && std::chrono::steady_clock::now() >= deadline) || (control && control->stop && control->stop->load()))) {
+                // The moves which are done still count, the others are called back
+                stopping = true;
+                stopped = true;
+                queue.clear();
+                for(struct worker_state& worker : state) {
+                    if(worker.alive && worker.busy) {
+                        std::ostringstream stop;
+                        stop << "stop " << worker.job;
+                        send_line(worker.conn.fd, stop.str());
+                    }
+                }
+            }
+        }
+
+        if(best_index < 0)
+            break;
+        best.eval = best_score;
+        best.move = root_moves[best_index];
+        best.best_move[0] = movegen::move_from(best.move);
+        best.best_move[1] = movegen::move_to(best.move);
+        progress.score = best_score;
+        progress.pv = best_pv;
+        progress.lines.assign(1, {best_score, best_pv});
+        if(stopped)
+            break; // As in think, the previous best move went first, so this one is at least as good
+        progress.depth = depth;
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if(control && control->on_progress)
+            control->on_progress(progress);
+
+        // The best move goes first next time, the rest stay in their order
+        std::rotate(root_moves.begin(), root_moves.begin() + best_index, root_moves.begin() + best_index + 1);
+        std::rotate(last_worker.begin(), last_worker.begin() + best_index, last_worker.begin() + best_index + 1);
+
+        if(std::abs(best_score) >= MATE_SCORE)
+            break;
+        if(limits.time_ms > 0 && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(limits.time_ms) / 2)
+            break;
+    }
+
+    if(info) {
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        *info = progress;
+    }
+    return best;
+}
@@ -0,0 +1,48 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+#define CLUSTER_CONNECT_TIMEOUT_MS 10000
+#define CLUSTER_POLL_MS 20 // How often the coordinator looks at the clock and the stop flag while it waits
+
+namespace NerdChess {
+namespace engine {
+namespace cluster {
+// Search split between processes, which may run on other NUMA nodes with their own memory and hash table.
+// The coordinator runs the iterative deepening and hands out the root moves to the worker processes, one
+// at a time per worker. The first move (the best one of the previous depth) is searched alone with the full
+// window, the others then go out in parallel with the best score so far as their bound, so that they only
+// need to prove they are not better, like in search(). Workers search the position after the move with
+// search_window and stream back one result line per move; a move goes back to the worker which searched it
+// at the previous depth if that one is free, so that its hash table still has the subtree.
+//
+// Workers and the coordinator talk over stream sockets, a Unix domain socket ("unix:/path") or TCP
+// ("host:port", meant for the loopback address), with one text line per message:
+//   job ID NEW DEPTH ALPHA BETA POSITION HISTORY  coordinator to worker, search the position to DEPTH
+//   stop ID                                       coordinator to worker, finish the job right away
+//   done ID DEPTH SCORE NODES PV                  worker to coordinator, DEPTH is the completed depth (-1 if none)
+// NEW is 1 for the first job a worker gets in a search (think), which is when it ages its hash table; the
+// later ones keep what the worker found so far. POSITION is the side to move, castling rights, en pessant
+// square, halfmove clock and the 12 bitboards, HISTORY the number of game keys before it followed by the
+// keys (see think). POSIX only.
+int listen_on(const std::string& address); // Listening socket, or -1
+int accept_worker(int listener, int timeout_ms); // Connection of the next worker, or -1 after timeout_ms
+int connect_to(const std::string& address, int timeout_ms); // Retries until the coordinator listens
+void close_socket(int fd);
+
+// Serves jobs from the coordinator on fd until it closes the connection
+void run_worker(int fd, const struct config& cfg);
+
+// Same interface as engine::think, on the connected workers instead of this process. Workers which go away
+// are left out, their move is given to another one. config::multi_pv isn't supported.
+struct engine_eval think(const std::vector<int>& workers, const struct board::position& root, bool side, const struct search_limits& limits,
+                         struct search_info* info, const struct search_control* control = nullptr, const std::vector<uint64_t>* history = nullptr);
+} // namespace cluster
+} // namespace engine
+} // namespace NerdChess
+
+#endif
@@ -1,63 +1,632 @@
 #include <iostream>
 #include <thread>
 #include <vector>
+#include <cstring>
 #include "engine.h"
+#include "mcts.h"
 
-struct NerdChess::engine::engine_eval NerdChess::engine::minimax(struct board::position pos, bool maximizing, int alpha, int beta, uint8_t depth) {
+// State of one running search
+struct search_context {
+    const struct NerdChess::engine::config* cfg;
+    struct NerdChess::engine::tt::hash_table* hash; // cfg->hash, nullptr without config::use_hash
+    bool timed;
+    std::chrono::steady_clock::time_point deadline;
+    bool stopped; // Set once the time is up or a stop was requested, every node returns right away after that
+    uint64_t nodes;
+    NerdChess::movegen::move root_move; // Best move of the previous iteration, tried first at the root
+    NerdChess::movegen::move killers[MAX_PLY][2]; // Quiet moves which caused a cutoff at the same ply
+    const std::atomic<bool>* stop; // Set by another thread to stop the search, may be nullptr
+    // Principal variation: pv[ply] is the best line found from ply on, pv_length[ply] moves long
+    NerdChess::movegen::move pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+    // Hashes of the game positions before the root (keys[0..game_keys)), followed by the position at every ply
+    // of the current line. Nothing older than the fifty-move rule allows can repeat, so the game part stays short.
+    uint64_t keys[MAX_GAME_KEYS + MAX_PLY];
+    int game_keys;
+};
+
+// Children of a depth 1 node, which all start their quiescence search with the static evaluation. They are
+// made EVAL_BATCH at a time and evaluated together (see eval::eval_batch), the search then takes them one by one.
+struct child_batch {
+    struct NerdChess::board::position positions[EVAL_BATCH];
+    NerdChess::movegen::move moves[EVAL_BATCH];
+    int evals[EVAL_BATCH];
+    int size;
+    int next;
+};
+
+static const struct NerdChess::engine::config default_config = NerdChess::engine::get_default_config();
+
+static inline bool out_of_time(struct search_context& ctx) {
+    // Looking at the clock every node would be too slow, the stop flag is cheap enough
+    if((ctx.nodes & 1023) == 0 && ctx.timed && std::chrono::steady_clock::now() >= ctx.deadline)
+        ctx.stopped = true;
+    if(ctx.stop && ctx.stop->load(std::memory_order_relaxed))
+        ctx.stopped = true;
+    return ctx.stopped;
+}
+
+static inline int evaluate(const struct search_context& ctx, const struct NerdChess::board::position& pos, bool side) {
+    return ctx.cfg->use_bitbases ? NerdChess::eval::eval_position(pos, side) : NerdChess::eval::eval_position(pos);
+}
+
+// Mate scores count the remaining depth from the root, in the hash table they are stored relative to the
+// position instead so that they stay right when the position comes up again at another depth
+static inline int score_to_tt(int score, int depth) {
+    if(score >= MATE_SCORE)
+        return score - depth;
+    if(score <= -MATE_SCORE)
+        return score + depth;
+    return score;
+}
+
+// Bounds of a window which is still fully open (+-INT_MAX) are not mate scores
+static inline bool is_mate_score(int score) {
+    return std::abs(score) >= MATE_SCORE - MAX_PLY && std::abs(score) != INT_MAX;
+}
+
+static inline int score_from_tt(int score, int depth) {
+    if(score >= MATE_SCORE - MAX_PLY)
+        return score + depth;
+    if(score <= -(MATE_SCORE - MAX_PLY))
+        return score - depth;
+    return score;
+}
+
+// Repetition or fifty-move rule. Only positions since the last capture or pawn move can repeat and only
+// every second one has the same side to move. A single repetition is enough, whatever the side to move
+// could do about it once it can do again.
+static inline bool is_draw(const struct search_context& ctx, const struct NerdChess::board::position& pos, int ply) {
+    if(pos.halfmove_clock >= 100)
+        return true;
+    const int current = ctx.game_keys + ply;
+    const int oldest = std::max(0, current - pos.halfmove_clock);
+    for(int i = current - 4; i >= oldest; i -= 2) {
+        if(ctx.keys[i] == pos.key)
+            return true;
+    }
+    return false;
+}
+
+// Quiescence search: below the horizon only captures and promotions are searched, until the position is quiet,
+// so that the static evaluation is never taken in the middle of an exchange. The side to move may always
+// stand pat on the static evaluation instead, except in check, where every evasion is searched. Captures
+// which lose material by the static exchange evaluation are skipped (see move_picker). static_eval is the
+// evaluation of pos if the caller already has it, NO_EVAL otherwise.
+template<bool Us>
+static int quiescence(struct search_context& ctx, const struct NerdChess::board::position& pos, int alpha, int beta, int ply, int static_eval = NO_EVAL) {
+    constexpr bool maximizing = (Us == WHITE);
+    ctx.nodes++;
+    STATS_INC(quiescence_nodes);
+    if(out_of_time(ctx))
+        return 0;
+    const int winner = NerdChess::eval::get_winner(pos);
+    if(winner != WINNER_NONE)
+        return winner * MATE_SCORE;
+
+    const bool check = NerdChess::movegen::in_check<Us>(pos);
     int evaluation = maximizing ? -INT_MAX : INT_MAX;
-    struct NerdChess::engine::engine_eval eval;
+    if(!check || ply >= MAX_PLY) {
+        if(static_eval != NO_EVAL) {
+            evaluation = static_eval;
+        } else {
+            STATS_INC(eval_calls);
+            STATS_TIMER_START(eval_start);
+            evaluation = evaluate(ctx, pos, Us);
+            STATS_TIMER_STOP(eval_start, eval_ticks);
+        }
+        if(ply >= MAX_PLY)
+            return evaluation;
+        if(maximizing ? evaluation >= beta : evaluation <= alpha)
+            return evaluation;
+        if(maximizing)
+            alpha = std::max(alpha, evaluation);
+        else
+            beta = std::min(beta, evaluation);
+    }
+
+    struct NerdChess::engine::move_picker picker;
+    if(check)
+        NerdChess::engine::init_picker(picker, pos, NO_MOVE, nullptr);
+    else
+        NerdChess::engine::init_quiescence_picker(picker, pos);
+
+    int searched = 0;
+    NerdChess::movegen::move move;
+    while((move = NerdChess::engine::next_move<Us>(picker)) != NO_MOVE) {
+        searched++;
+        struct NerdChess::board::position hypothetical_board = pos;
+        NerdChess::movegen::make_move(hypothetical_board, move);
+        const int score = quiescence<!Us>(ctx, hypothetical_board, alpha, beta, ply + 1);
+        if(ctx.stopped)
+            return 0;
+
+        if(maximizing ? score > evaluation : score < evaluation)
+            evaluation = score;
+        if(maximizing)
+            alpha = std::max(alpha, evaluation);
+        else
+            beta = std::min(beta, evaluation);
+        if(alpha >= beta)
+            break;
+    }
+
+    // Checkmate, scored like one found by the search at depth 0
+    if(check && searched == 0)
+        return maximizing ? -MATE_SCORE : MATE_SCORE;
+    return evaluation;
+}
+
+// Makes and evaluates the next EVAL_BATCH moves of the picker, returns false if there are none left
+template<bool Us>
+static bool fill_batch(const struct search_context& ctx, struct NerdChess::engine::move_picker& picker, const struct NerdChess::board::position& pos, struct child_batch& batch) {
+    const struct NerdChess::board::position* positions[EVAL_BATCH];
+    NerdChess::movegen::move move;
+    batch.size = batch.next = 0;
+    while(batch.size < EVAL_BATCH && (move = NerdChess::engine::next_move<Us>(picker)) != NO_MOVE) {
+        batch.moves[batch.size] = move;
+        batch.positions[batch.size] = pos;
+        NerdChess::movegen::make_move(batch.positions[batch.size], move);
+        positions[batch.size] = &batch.positions[batch.size];
+        batch.size++;
+    }
+    if(batch.size == 0)
+        return false;
+    STATS_ADD(eval_calls, batch.size);
+    STATS_TIMER_START(eval_start);
+    if(ctx.cfg->use_bitbases)
+        NerdChess::eval::eval_batch(positions, batch.size, !Us, batch.evals);
+    else
+        NerdChess::eval::eval_batch(positions, batch.size, batch.evals);
+    STATS_TIMER_STOP(eval_start, eval_ticks);
+    return true;
+}
+
+// After a cutoff on an exact hash entry nothing below the node was searched this time, so the line is read
+// back out of the table by following the hash moves, at most length moves. It ends at a move which isn't
+// legal (a collision) or a position which is already on the line.
+static void pv_from_tt(struct search_context& ctx, const struct NerdChess::board::position& pos, bool side, int ply, NerdChess::movegen::move move, int length) {
+    struct NerdChess::board::position line = pos;
+    uint64_t keys[MAX_PLY];
+    int count = 0;
+    length = std::min(length, MAX_PLY - ply);
+    while(count < length && move != NO_MOVE && (side ? NerdChess::movegen::is_legal<BLACK>(line, move) : NerdChess::movegen::is_legal<WHITE>(line, move))) {
+        keys[count] = line.key;
+        ctx.pv[ply][count++] = move;
+        NerdChess::movegen::make_move(line, move);
+        side = !side;
+        if(std::find(keys, keys + count, line.key) != keys + count)
+            break;
+        const struct NerdChess::engine::tt::entry* found = ctx.hash->peek(line.key);
+        move = found ? found->move : NO_MOVE;
+    }
+    ctx.pv_length[ply] = count;
+}
+
+// Us is the side to move. White maximizes and black minimizes the evaluation, which used to be decided
+// by a runtime flag at every move; as a template parameter the comparisons below are resolved at compile time.
+// static_eval is passed on to the quiescence search at depth 0, see quiescence.
+template<bool Us>
+static struct NerdChess::engine::engine_eval search(struct search_context& ctx, const struct NerdChess::board::position& pos, int alpha, int beta, uint8_t depth, int ply, int static_eval = NO_EVAL) {
+    constexpr bool maximizing = (Us == WHITE);
+    int evaluation = maximizing ? -INT_MAX : INT_MAX;
+    int searched = 0; // Number of moves tried so far
+    struct NerdChess::engine::engine_eval eval = {0, {-1, -1}, NO_MOVE};
+    TRACE_NODE(trace_node, ctx.nodes, ply, depth, alpha, beta, eval.eval);
+    ctx.nodes++;
+    if(ply < MAX_PLY) {
+        ctx.pv_length[ply] = 0;
+        ctx.keys[ctx.game_keys + ply] = pos.key;
+    }
+    STATS_INC(nodes);
+    STATS_INC(nodes_by_depth[depth < STATS_MAX_DEPTH ? depth : STATS_MAX_DEPTH - 1]);
+    if(out_of_time(ctx)) {
+        TRACE_REASON(trace_node, TRACE_STOPPED);
+        return eval;
+    }
     const int winner = NerdChess::eval::get_winner(pos);
 
     if(winner != WINNER_NONE) {
-        eval.eval = winner * (INT_MAX-1);
+        TRACE_REASON(trace_node, TRACE_MATE);
+        eval.eval = winner * (MATE_SCORE + depth);
+        return eval;
+    } else if(ply > 0 && ply < MAX_PLY && is_draw(ctx, pos, ply)) {
+        // Going around in a circle, the line can't be better than a draw
+        TRACE_REASON(trace_node, TRACE_DRAW);
+        eval.eval = 0;
         return eval;
     } else if(depth == 0) {
-        eval.eval = eval::eval_position(pos);
+        STATS_INC(leaf_nodes);
+        TRACE_REASON(trace_node, TRACE_LEAF);
+        eval.eval = quiescence<Us>(ctx, pos, alpha, beta, ply, static_eval);
+        return eval;
+    } else if(ply > 0 && ctx.cfg->use_bitbases && NerdChess::bitbase::probe(pos, Us) != BITBASE_UNKNOWN) {
+        // The result of this endgame is known, searching it any deeper would be a waste
+        TRACE_REASON(trace_node, TRACE_BITBASE);
+        eval.eval = evaluate(ctx, pos, Us);
         return eval;
-    } else {
-        for(int i = 0; i < 64; ++i) {
-            if(board::piece_color_at(pos, i, !maximizing)) { // I f*cked up with the values, so (WHITE == false), sorry
-                std::vector<int> moves = board::get_moves(pos, i, board::get_piece_type(pos, i), !maximizing, false);
-
-                for(int j = 0; j < moves.size(); ++j) {
-                    if(maximizing) {
-                        // Attempt each move and call minimax on the hypothetical boards
-                        struct board::position hypothetical_board = pos;
-                        board::move_piece(hypothetical_board, i, moves[j]);
-
-                        struct NerdChess::engine::engine_eval hypothetical_eval = minimax(hypothetical_board, !maximizing, alpha, beta, depth - 1);
-
-                        if(hypothetical_eval.eval > evaluation) {
-                            evaluation = hypothetical_eval.eval;
-                            eval.best_move[0] = i;
-                            eval.best_move[1] = moves[j];
-                        }
-
-                        alpha = std::max(alpha, evaluation);
-                        if(alpha >= beta)
-                            break;
-                    } else {
-                        // Attempt each move and call minimax on the hypothetical boards
-                        struct board::position hypothetical_board = pos;
-                        board::move_piece(hypothetical_board, i, moves[j]);
-
-                        struct NerdChess::engine::engine_eval hypothetical_eval = minimax(hypothetical_board, !maximizing, alpha, beta, depth - 1);
-
-                        if(hypothetical_eval.eval < evaluation) {
-                            evaluation = hypothetical_eval.eval;
-                            eval.best_move[0] = i;
-                            eval.best_move[1] = moves[j];
-                        }
-
-                        beta = std::min(beta, evaluation);
-                        if(alpha >= beta)
-                            break;
-                    }
-                }
+    }
+
+    // A result from the hash table is good enough if it was searched at least as deep and its bound
+    // is on the right side of the window. The move is tried first either way.
+    NerdChess::movegen::move hash_move = NO_MOVE;
+    if(ctx.hash) {
+        const struct NerdChess::engine::tt::entry* found = ctx.hash->probe(pos.key);
+        if(found) {
+            const struct NerdChess::engine::tt::entry entry = *found; // A copy, the subtree below may store into the same bucket
+            const int score = score_from_tt(entry.score, depth);
+            const int bound = entry.gen_bound & 3;
+            hash_move = entry.move;
+            if(ply > 0 && entry.depth >= depth && (bound == TT_EXACT || (bound == TT_LOWER && score >= beta) || (bound == TT_UPPER && score <= alpha))) {
+                eval.eval = score;
+                eval.move = hash_move;
+                eval.best_move[0] = hash_move != NO_MOVE ? NerdChess::movegen::move_from(hash_move) : -1;
+                eval.best_move[1] = hash_move != NO_MOVE ? NerdChess::movegen::move_to(hash_move) : -1;
+                if(bound == TT_EXACT && ply < MAX_PLY)
+                    pv_from_tt(ctx, pos, Us, ply, hash_move, entry.depth);
+                TRACE_REASON(trace_node, TRACE_HASH);
+                return eval;
+            }
+        }
+    }
+    if(ply == 0 && ctx.root_move != NO_MOVE)
+        hash_move = ctx.root_move;
+    const int alpha_start = alpha, beta_start = beta;
+
+    // Near the leaves a static evaluation far outside the window is rarely brought back by a single quiet
+    // move. Not in check (every evasion counts) and not while a mate score is at stake, where the
+    // evaluation says nothing.
+    bool futile = false;
+    int futility_score = 0; // What a quiet move skipped by futility pruning is assumed to be worth at most
+    if(ply > 0 && depth <= FUTILITY_DEPTH && ctx.cfg->use_pruning && !is_mate_score(alpha) && !is_mate_score(beta)
+        && !NerdChess::movegen::in_check<Us>(pos)) {
+        // Children of a batched depth 1 node already come with their evaluation
+        if(static_eval == NO_EVAL)
+            STATS_INC(eval_calls);
+        const int node_eval = static_eval != NO_EVAL ? static_eval : evaluate(ctx, pos, Us);
+        // The side to move is already so far ahead that the opponent would never allow this position
+        const int reverse_margin = ctx.cfg->reverse_futility_margin * depth;
+        if(maximizing ? node_eval - reverse_margin >= beta : node_eval + reverse_margin <= alpha) {
+            STATS_INC(reverse_futility_cutoffs);
+            TRACE_REASON(trace_node, TRACE_REVERSE_FUTILITY);
+            eval.eval = node_eval;
+            return eval;
+        }
+        // So far behind that only a capture could help: check that with the quiescence search
+        const int razor_margin = ctx.cfg->razor_margin * depth;
+        if(depth <= RAZOR_DEPTH && (maximizing ? node_eval + razor_margin <= alpha : node_eval - razor_margin >= beta)) {
+            const int score = quiescence<Us>(ctx, pos, alpha, beta, ply, node_eval);
+            if(ctx.stopped || (maximizing ? score <= alpha : score >= beta)) {
+                STATS_INC(razor_cutoffs);
+                TRACE_REASON(trace_node, ctx.stopped ? TRACE_STOPPED : TRACE_RAZOR);
+                eval.eval = score;
+                return eval;
+            }
+        }
+        const int futility_margin = ctx.cfg->futility_margin * depth;
+        futility_score = maximizing ? node_eval + futility_margin : node_eval - futility_margin;
+        futile = maximizing ? futility_score <= alpha : futility_score >= beta;
+    }
+
+    // Moves are generated lazily in stages, see movepick.h
+    struct NerdChess::engine::move_picker picker;
+    NerdChess::engine::init_picker(picker, pos, hash_move, ply < MAX_PLY ? ctx.killers[ply] : nullptr);
+
+    // The first move often cuts off on its own and is searched alone, the moves after it are batched at depth 1
+    // (except when most of them are about to be pruned by futility)
+    const bool batched = depth == 1 && !futile;
+    struct child_batch batch;
+    batch.size = batch.next = 0;
+
+    NerdChess::movegen::move move;
+    while(true) {
+        // Attempt each move and call minimax on the hypothetical boards
+        struct NerdChess::board::position made;
+        const struct NerdChess::board::position* child = &made;
+        int child_eval = NO_EVAL;
+        if(batched && searched > 0) {
+            if(batch.next == batch.size && !fill_batch<Us>(ctx, picker, pos, batch))
+                break;
+            move = batch.moves[batch.next];
+            child = &batch.positions[batch.next];
+            child_eval = batch.evals[batch.next++];
+        } else {
+            if((move = NerdChess::engine::next_move<Us>(picker)) == NO_MOVE)
+                break;
+            made = pos;
+            NerdChess::movegen::make_move(made, move);
+        }
+        const struct NerdChess::board::position& hypothetical_board = *child;
+        searched++;
+
+        // Futility pruning: quiet moves which don't give check can't reach the window
+        if(futile && !NerdChess::movegen::is_capture(pos, move) && !NerdChess::movegen::in_check<!Us>(hypothetical_board)) {
+            STATS_INC(futility_pruned);
+            evaluation = maximizing ? std::max(evaluation, futility_score) : std::min(evaluation, futility_score);
+            continue;
+        }
+        // Loaded while the child generates its moves. At depth 0 the child goes straight to the quiescence
+        // search, which doesn't probe.
+        if(ctx.hash && depth > 1)
+            ctx.hash->prefetch(hypothetical_board.key);
+
+        TRACE_MOVE(ply, move);
+        const struct NerdChess::engine::engine_eval hypothetical_eval = search<!Us>(ctx, hypothetical_board, alpha, beta, depth - 1, ply + 1, child_eval);
+        if(ctx.stopped) {
+            TRACE_REASON(trace_node, TRACE_STOPPED);
+            // At the root the moves searched completely still count, think() decides whether to use them
+            if(ply == 0)
+                eval.eval = evaluation;
+            return eval;
+        }
+
+        if(maximizing ? hypothetical_eval.eval > evaluation : hypothetical_eval.eval < evaluation) {
+            evaluation = hypothetical_eval.eval;
+            eval.best_move[0] = NerdChess::movegen::move_from(move);
+            eval.best_move[1] = NerdChess::movegen::move_to(move);
+            eval.move = move;
+
+            if(ply < MAX_PLY - 1) {
+                const int length = std::min(ctx.pv_length[ply + 1], MAX_PLY - 1 - ply);
+                ctx.pv[ply][0] = move;
+                memcpy(&ctx.pv[ply][1], ctx.pv[ply + 1], length * sizeof(NerdChess::movegen::move));
+                ctx.pv_length[ply] = length + 1;
+            }
+        }
+
+        if(maximizing)
+            alpha = std::max(alpha, evaluation);
+        else
+            beta = std::min(beta, evaluation);
+
+        if(alpha >= beta) {
+            STATS_INC(cutoffs);
+            TRACE_REASON(trace_node, TRACE_CUTOFF);
+            if(searched == 1)
+                STATS_INC(first_move_cutoffs);
+            // Remember quiet refutations, they are likely to refute the sibling positions as well
+            if(ply < MAX_PLY && move != ctx.killers[ply][0] && !NerdChess::movegen::is_capture(pos, move)) {
+                ctx.killers[ply][1] = ctx.killers[ply][0];
+                ctx.killers[ply][0] = move;
             }
+            break;
         }
+    }
+
+    // No legal moves: checkmate (a faster mate, found with more depth left, scores higher) or stalemate
+    if(searched == 0) {
+        TRACE_REASON(trace_node, TRACE_MATE);
+        if(NerdChess::movegen::in_check<Us>(pos))
+            eval.eval = maximizing ? -(MATE_SCORE + depth) : (MATE_SCORE + depth);
+        else
+            eval.eval = 0;
+        return eval;
+    }
+
+    STATS_INC(interior_nodes);
+    STATS_ADD(moves_searched, searched);
+
+    if(ctx.hash) {
+        const int bound = evaluation <= alpha_start ? TT_UPPER : evaluation >= beta_start ? TT_LOWER : TT_EXACT;
+        ctx.hash->store(pos.key, eval.move, score_to_tt(evaluation, depth), depth, bound);
+    }
+
+    eval.eval = evaluation;
+    return eval;
+}
+
+// MultiPV root: every root move is searched once, with a window which only lets it in if it beats the worst of
+// the best multi_pv lines so far. Moves outside the top lines fail low as cheaply as in a normal search, and
+// the lines share the hash table (and killers) of this one search. The moves of the best lines go first next time.
+template<bool Us>
+static struct NerdChess::engine::engine_eval search_multi_pv(struct search_context& ctx, const struct NerdChess::board::position& pos, uint8_t depth,
+                                                             std::vector<NerdChess::movegen::move>& root_moves, std::vector<struct NerdChess::engine::pv_line>& lines) {
+    constexpr bool maximizing = (Us == WHITE);
+    const size_t count = ctx.cfg->multi_pv;
+    struct NerdChess::engine::engine_eval eval = {0, {-1, -1}, NO_MOVE};
+    lines.clear();
+    ctx.nodes++;
+    ctx.pv_length[0] = 0;
+    ctx.keys[ctx.game_keys] = pos.key;
+
+    for(NerdChess::movegen::move move : root_moves) {
+        const int bound = lines.size() < count ? (maximizing ? -INT_MAX : INT_MAX) : lines.back().score;
+        struct NerdChess::board::position hypothetical_board = pos;
+        NerdChess::movegen::make_move(hypothetical_board, move);
+        if(ctx.hash && depth > 1)
+            ctx.hash->prefetch(hypothetical_board.key);
+
+        TRACE_MOVE(0, move);
+        const struct NerdChess::engine::engine_eval hypothetical_eval = maximizing ? search<!Us>(ctx, hypothetical_board, bound, INT_MAX, depth - 1, 1)
+                                                                                   : search<!Us>(ctx, hypothetical_board, -INT_MAX, bound, depth - 1, 1);
+        if(ctx.stopped)
+            break;
+        if(lines.size() == count && (maximizing ? hypothetical_eval.eval <= bound : hypothetical_eval.eval >= bound))
+            continue;
+
+        struct NerdChess::engine::pv_line line;
+        line.score = hypothetical_eval.eval;
+        line.pv.push_back(move);
+        line.pv.insert(line.pv.end(), ctx.pv[1], ctx.pv[1] + ctx.pv_length[1]);
+        // Sorted insert, a later move only goes before an earlier one if it is strictly better
+        std::vector<struct NerdChess::engine::pv_line>::iterator at = lines.begin();
+        while(at != lines.end() && (maximizing ? at->score >= line.score : at->score <= line.score))
+            ++at;
+        lines.insert(at, line);
+        if(lines.size() > count)
+            lines.pop_back();
+    }
 
-        eval.eval = evaluation;
+    if(lines.empty())
         return eval;
+    eval.eval = lines[0].score;
+    eval.move = lines[0].pv[0];
+    eval.best_move[0] = NerdChess::movegen::move_from(eval.move);
+    eval.best_move[1] = NerdChess::movegen::move_to(eval.move);
+    ctx.pv_length[0] = std::min<int>(lines[0].pv.size(), MAX_PLY);
+    std::copy(lines[0].pv.begin(), lines[0].pv.begin() + ctx.pv_length[0], ctx.pv[0]);
+    if(!ctx.stopped) {
+        std::vector<NerdChess::movegen::move> order;
+        for(const struct NerdChess::engine::pv_line& line : lines)
+            order.push_back(line.pv[0]);
+        for(NerdChess::movegen::move move : root_moves) {
+            if(std::find(order.begin(), order.end(), move) == order.end())
+                order.push_back(move);
+        }
+        root_moves.swap(order);
+    }
+    return eval;
+}
+
+struct NerdChess::engine::config NerdChess::engine::get_default_config() {
+    struct config cfg;
+    cfg.use_bitbases = true;
+    cfg.use_hash = true;
+    cfg.hash = &tt::default_table;
+    cfg.params = nullptr;
+    cfg.multi_pv = 1;
+    cfg.use_pruning = true;
+    cfg.futility_margin = 150;
+    cfg.reverse_futility_margin = 120;
+    cfg.razor_margin = 300;
+    cfg.mode = SEARCH_ALPHA_BETA;
+    cfg.threads = 1;
+    cfg.mcts_cpuct = 150;
+    cfg.mcts_playout = 0;
+    cfg.mcts_pool_mb = MCTS_DEFAULT_POOL_MB;
+    return cfg;
+}
+
+struct NerdChess::engine::engine_eval NerdChess::engine::minimax(const struct board::position& root, bool maximizing, int alpha, int beta, uint8_t depth) {
+    struct search_context ctx = {&default_config, default_config.hash, false, {}, false, 0, NO_MOVE, {}, nullptr, {}, {}, {}, 0};
+    struct board::position pos = root;
+    pos.side = !maximizing;
+    pos.key = board::compute_key(pos);
+    if(ctx.hash)
+        ctx.hash->new_search();
+    return maximizing ? search<WHITE>(ctx, pos, alpha, beta, depth, 0) : search<BLACK>(ctx, pos, alpha, beta, depth, 0);
+}
+
+// Iterative deepening: searches depth 1, 2, ... until the depth or time limit is reached or the search is
+// stopped. Of an unfinished iteration only the root moves which were searched completely are used.
+// With config::mode SEARCH_MCTS the Monte Carlo tree search runs instead.
+struct NerdChess::engine::engine_eval NerdChess::engine::think(const struct board::position& root, bool side, const struct search_limits& limits, const struct config& cfg, struct search_info* info, const struct search_control* control, const std::vector<uint64_t>* history) {
+    const eval::params_scope scope(cfg.params);
+    if(cfg.mode == SEARCH_MCTS)
+        return mcts::think(root, side, limits, cfg, info, control, history);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    struct search_context ctx = {&cfg, cfg.use_hash ? cfg.hash : nullptr, limits.time_ms > 0, start + std::chrono::milliseconds(limits.time_ms), false, 0, NO_MOVE, {}, control ? control->stop : nullptr, {}, {}, {}, 0};
+    struct engine_eval best = {0, {-1, -1}, NO_MOVE};
+    struct search_info progress = {0, 0, {}, 0, 0, {}};
+    struct board::position pos = root;
+    pos.side = side;
+    pos.key = board::compute_key(pos);
+    if(ctx.hash)
+        ctx.hash->new_search();
+    if(history) {
+        ctx.game_keys = std::min<int>(history->size(), std::min<int>(pos.halfmove_clock, MAX_GAME_KEYS));
+        std::copy(history->end() - ctx.game_keys, history->end(), ctx.keys);
+    }
+
+    // Make sure there is a move to play even if not even depth 1 finishes
+    struct movegen::move_list moves;
+    movegen::generate(pos, side, moves);
+    if(moves.size > 0) {
+        best.move = moves.moves[0];
+        best.best_move[0] = movegen::move_from(best.move);
+        best.best_move[1] = movegen::move_to(best.move);
+    }
+
+    const bool multi_pv = cfg.multi_pv > 1;
+    std::vector<movegen::move> root_moves(moves.moves, moves.moves + moves.size); // Only used by MultiPV
+    std::vector<struct pv_line> lines;
+
+    for(int depth = 1; depth <= limits.depth && moves.size > 0; ++depth) {
+        ctx.root_move = best.move;
+        struct engine_eval eval;
+        if(multi_pv)
+            eval = side ? search_multi_pv<BLACK>(ctx, pos, depth, root_moves, lines) : search_multi_pv<WHITE>(ctx, pos, depth, root_moves, lines);
+        else
+            eval = side ? search<BLACK>(ctx, pos, -INT_MAX, INT_MAX, depth, 0) : search<WHITE>(ctx, pos, -INT_MAX, INT_MAX, depth, 0);
+        if(!multi_pv)
+            lines.assign(1, {eval.eval, std::vector<movegen::move>(ctx.pv[0], ctx.pv[0] + ctx.pv_length[0])});
+        if(ctx.stopped) {
+            // The previous best move is searched first, so a move from the unfinished iteration
+            // is either that one at a greater depth or one which already did better. Unfinished MultiPV
+            // lines are missing the moves searched last, they are only better than nothing.
+            if(eval.move != NO_MOVE && (!multi_pv || progress.lines.empty())) {
+                best = eval;
+                progress.score = eval.eval;
+                progress.pv.assign(ctx.pv[0], ctx.pv[0] + ctx.pv_length[0]);
+                progress.lines = lines;
+            }
+            break;
+        }
+        best = eval;
+        progress.depth = depth;
+        progress.score = eval.eval;
+        progress.pv.assign(ctx.pv[0], ctx.pv[0] + ctx.pv_length[0]);
+        progress.lines = lines;
+        progress.nodes = ctx.nodes;
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if(control && control->on_progress)
+            control->on_progress(progress);
+
+        // A forced mate won't change with more depth
+        if(std::abs(eval.eval) >= MATE_SCORE)
+            break;
+        // The next iteration takes several times longer than this one, don't start what can't be finished
+        if(ctx.timed && std::chrono::steady_clock::now() - start > std::chrono::milliseconds(limits.time_ms) / 2)
+            break;
+    }
+
+    TRACE_FLUSH();
+    if(info) {
+        progress.nodes = ctx.nodes;
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        *info = progress;
+    }
+    return best;
+}
+
+struct NerdChess::engine::engine_eval NerdChess::engine::search_window(const struct board::position& root, bool side, int depth, int alpha, int beta, const struct config& cfg, struct search_info* info, const struct search_control* control, const std::vector<uint64_t>* history) {
+    const eval::params_scope scope(cfg.params);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    struct search_context ctx = {&cfg, cfg.use_hash ? cfg.hash : nullptr, false, {}, false, 0, NO_MOVE, {}, control ? control->stop : nullptr, {}, {}, {}, 0};
+    struct engine_eval best = {0, {-1, -1}, NO_MOVE};
+    struct search_info progress = {-1, 0, {}, 0, 0, {}};
+    struct board::position pos = root;
+    pos.side = side;
+    pos.key = board::compute_key(pos);
+    if(history) {
+        ctx.game_keys = std::min<int>(history->size(), std::min<int>(pos.halfmove_clock, MAX_GAME_KEYS));
+        std::copy(history->end() - ctx.game_keys, history->end(), ctx.keys);
+    }
+
+    // search() only looks for repetitions below its root, here the root is already one move into the game
+    ctx.keys[ctx.game_keys] = pos.key;
+    if(is_draw(ctx, pos, 0))
+        progress.depth = depth;
+    for(int d = depth > 0 ? 1 : 0; d <= depth && progress.depth < depth; ++d) {
+        ctx.root_move = best.move;
+        const struct engine_eval eval = side ? search<BLACK>(ctx, pos, alpha, beta, d, 0) : search<WHITE>(ctx, pos, alpha, beta, d, 0);
+        if(ctx.stopped)
+            break;
+        best = eval;
+        progress.depth = d;
+        progress.score = eval.eval;
+        progress.pv.assign(ctx.pv[0], ctx.pv[0] + ctx.pv_length[0]);
+        progress.nodes = ctx.nodes;
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if(control && control->on_progress)
+            control->on_progress(progress);
+    }
+
+    TRACE_FLUSH();
+    if(info) {
+        progress.nodes = ctx.nodes;
+        progress.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        *info = progress;
     }
+    return best;
 }
@@ -5,16 +5,94 @@
 #include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <vector>
 #include "eval.h"
+#include "movegen.h"
+#include "movepick.h"
+#include "stats.h"
+#include "trace.h"
+#include "tt.h"
+
+// Score of a checkmate. The remaining depth is added to it so that faster mates are preferred.
+#define MATE_SCORE 30000
+// Game positions before the root which are checked for repetitions (the fifty-move rule ends the game before any older one could repeat)
+#define MAX_GAME_KEYS 100
+#define NO_EVAL INT_MIN // Static evaluation not known yet
+// Deepest remaining depth at which futility pruning and reverse futility pruning, and razoring, are tried
+#define FUTILITY_DEPTH 3
+#define RAZOR_DEPTH 2
+
+// config::mode
+#define SEARCH_ALPHA_BETA 0
+#define SEARCH_MCTS 1 // See mcts.h
 
 namespace NerdChess {
 namespace engine {
 struct engine_eval {
     int eval; // Position evaluation
     int best_move[2]; // Contains the numbers of the squares from and to which a piece needs to move to
+    movegen::move move; // The same move, including the piece a pawn promotes to
+};
+
+// Settings which can differ between two engines (e.g. in the match runner)
+struct config {
+    bool use_bitbases; // Probe the endgame bitbases in search and eval
+    bool use_hash; // Use the transposition table (see tt.h)
+    tt::hash_table* hash; // The table, tt::default_table unless the engine has one of its own
+    const int* params; // Eval parameters (see eval::params), nullptr for eval::params
+    int multi_pv; // Number of best root moves to find with exact scores (analysis), 1 to only find the best
+    // Pruning near the leaves (see search), the margins are in centipawns per ply of remaining depth
+    bool use_pruning;
+    int futility_margin; // Depth 1-3: quiet moves are skipped if the static eval is this far below alpha
+    int reverse_futility_margin; // Depth 1-3: fail high right away if the static eval is this far above beta
+    int razor_margin; // Depth 1-2: drop into quiescence search if the static eval is this far below alpha
+    int mode; // SEARCH_ALPHA_BETA or SEARCH_MCTS, think() runs either
+    int threads; // Threads of the MCTS search, alpha-beta uses one
+    int mcts_cpuct; // Weight of the MCTS exploration bonus, in hundredths
+    int mcts_playout; // Random moves played from an MCTS leaf before it is evaluated, 0 to evaluate it right away
+    int mcts_pool_mb; // Memory for the MCTS tree
+};
+
+struct search_limits {
+    int depth; // Maximum depth
+    int time_ms; // Time for this move, 0 for no limit
+};
+
+struct pv_line {
+    int score; // Positive if white is better
+    std::vector<movegen::move> pv; // Starting with the root move
+};
+
+struct search_info {
+    int depth; // Last completed depth
+    int score; // Positive if white is better
+    std::vector<movegen::move> pv; // Expected line, starting with the best move
+    uint64_t nodes;
+    int64_t time_ms;
+    std::vector<struct pv_line> lines; // The best config::multi_pv root moves, best first (the first one is score and pv)
+};
+
+// Lets another thread watch and stop a search (see searcher.h)
+struct search_control {
+    const std::atomic<bool>* stop; // Checked at every node. Once set the search returns its best move so far.
+    std::function<void(const struct search_info&)> on_progress; // Called after every completed depth
 };
 
-struct engine_eval minimax(struct board::position pos, bool maximizing, int alpha, int beta, uint8_t depth);
+struct config get_default_config();
+struct engine_eval minimax(const struct board::position& root, bool maximizing, int alpha, int beta, uint8_t depth);
+// history holds the hashes (position::key) of the game positions before root, oldest first, so that the
+// search can see repetitions of them. It may be nullptr.
+struct engine_eval think(const struct board::position& root, bool side, const struct search_limits& limits, const struct config& cfg, struct search_info* info,
+                         const struct search_control* control = nullptr, const std::vector<uint64_t>* history = nullptr);
+// Iterative deepening up to depth inside the window [alpha, beta], for searching one root move of a search
+// which is split up between processes (see cluster.h). The score is exact only if it falls inside the window.
+// info->depth is the last completed depth, -1 if the search was stopped before finishing any. The hash table
+// isn't aged, the caller runs tt::hash_table::new_search once for the whole split search.
+struct engine_eval search_window(const struct board::position& root, bool side, int depth, int alpha, int beta, const struct config& cfg, struct search_info* info,
+                                 const struct search_control* control = nullptr, const std::vector<uint64_t>* history = nullptr);
 } // namespace engine
 } // namespace NerdChess
 
@@ -1,9 +1,103 @@
 #include <iostream>
+#include <fstream>
 #include <math.h>
 #include "eval.h"
+#include "setwise.h"
+
+template<typename B, typename C>
+static void structure_features(const B pieces[], C features[]);
+
+#if defined(__AVX2__)
+static_assert(EVAL_BATCH == SETWISE_LANES, "a batch is one position per lane");
+#endif
 
 int NerdChess::board_control_value_map_w[64] = {0};
 int NerdChess::board_control_value_map_b[64] = {0};
+// What controlling a square is worth (the value map divided by 5, see eval_board_control) as bytes, for control_value
+alignas(32) static uint8_t control_weights[2][64] = {{0}};
+
+int NerdChess::eval::params[PARAM_COUNT] = {
+    PAWN_VALUE,
+    KNIGHT_VALUE,
+    BISHOP_VALUE,
+    ROOK_VALUE,
+    QUEEN_VALUE,
+    10, // Pawn near the center
+    10, // Pawn in the center
+    8, // Advanced pawn
+    15, // Knight near the center
+    -13, // Queen near the center
+    20, // King in the corner
+    10, // Passed pawn
+    8, // Passed pawn, per rank
+    -12, // Isolated pawn
+    -10, // Doubled pawn
+    -8, // Backward pawn
+    5, // Pawn chain
+    8, // King shield
+    100 // Board control
+};
+
+thread_local const int* NerdChess::eval::active_params = NerdChess::eval::params;
+
+const char* NerdChess::eval::param_names[PARAM_COUNT] = {
+    "pawn_value",
+    "knight_value",
+    "bishop_value",
+    "rook_value",
+    "queen_value",
+    "pawn_near_center",
+    "pawn_in_center",
+    "pawn_advanced",
+    "knight_near_center",
+    "queen_near_center",
+    "king_corner",
+    "passed_pawn",
+    "passed_pawn_rank",
+    "isolated_pawn",
+    "doubled_pawn",
+    "backward_pawn",
+    "pawn_chain",
+    "king_shield",
+    "control_weight"
+};
+
+const int NerdChess::eval::param_divisors[PARAM_COUNT] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 100};
+
+bool NerdChess::eval::load_params(const std::string& path, int* values) {
+    std::ifstream file(path);
+    if(!file)
+        return false;
+    std::string name;
+    int value;
+    while(file >> name >> value) {
+        int i = 0;
+        while(i < PARAM_COUNT && name != param_names[i])
+            i++;
+        if(i == PARAM_COUNT) {
+            std::cerr << "Unknown eval parameter " << name << "\n";
+            return false;
+        }
+        values[i] = value;
+    }
+    return file.eof();
+}
+
+bool NerdChess::eval::save_params(const std::string& path) {
+    std::ofstream file(path);
+    for(int i = 0; i < PARAM_COUNT; ++i)
+        file << param_names[i] << " " << params[i] << "\n";
+    return (bool)file;
+}
+
+void NerdChess::eval::eval_features(const struct board::position& pos, int features[PARAM_COUNT]) {
+    for(int i = 0; i < PARAM_COUNT; ++i)
+        features[i] = 0;
+    for(int piece = PAWN; piece <= QUEEN; ++piece)
+        features[PARAM_PAWN_VALUE + piece] = bitb::popcount(pos.pieces[piece]) - bitb::popcount(pos.pieces[piece + _BLACK]);
+    structure_features(pos.pieces, features);
+    features[PARAM_CONTROL_WEIGHT] = middlegame::eval_board_control(pos, WHITE) - middlegame::eval_board_control(pos, BLACK);
+}
 
 void NerdChess::generate_board_control_value_map(int* buf, bool piece_color) {
     if(!piece_color) {
@@ -21,143 +115,229 @@ void NerdChess::generate_board_control_value_map(int* buf, bool piece_color) {
             }
         }
     }
+    if(buf == board_control_value_map_w || buf == board_control_value_map_b) {
+        for(int i = 0; i < 64; ++i)
+            control_weights[buf == board_control_value_map_b][i] = (uint8_t)(buf[i] / 5);
+    }
 }
 
-int NerdChess::eval::get_winner(struct board::position pos) {
-    if(NerdChess::board::find_piece(pos.pieces[KING]) == -1)
+int NerdChess::eval::get_winner(const struct board::position& pos) {
+    // A missing king can only happen in positions set up by hand, legal move generation never captures one
+    if(!pos.pieces[KING])
         return WINNER_BLACK;
-    if(NerdChess::board::find_piece(pos.pieces[KING+_BLACK]) == -1)
+    if(!pos.pieces[KING+_BLACK])
         return WINNER_WHITE;
     return WINNER_NONE;
 }
 
-int NerdChess::eval::eval_material(struct NerdChess::board::position pos, int piece_map[]) {
+int NerdChess::eval::eval_material(const struct NerdChess::board::position& pos) {
     int eval = 0;
-    const NerdChess::bitb::bitboard _piece_map = board::map_pieces(pos);
-    const int piece_values[] = {
-        PAWN_VALUE,
-        KNIGHT_VALUE,
-        BISHOP_VALUE,
-        ROOK_VALUE,
-        QUEEN_VALUE,
-        1000000000,
-        -PAWN_VALUE,
-        -KNIGHT_VALUE,
-        -BISHOP_VALUE,
-        -ROOK_VALUE,
-        -QUEEN_VALUE,
-        -1000000000
-    };
-
-    for(int i = 0; i < 64; ++i) {
-        if(NerdChess::bitb::get_bit(_piece_map, i)) {
-            eval += piece_values[piece_map[i]];
-        }
-    }
+    for(int piece = PAWN; piece <= QUEEN; ++piece)
+        eval += (bitb::popcount(pos.pieces[piece]) - bitb::popcount(pos.pieces[piece + _BLACK])) * active_params[PARAM_PAWN_VALUE + piece];
+    // Only differs if a king is missing (see get_winner)
+    eval += (bitb::popcount(pos.pieces[KING]) - bitb::popcount(pos.pieces[KING + _BLACK])) * 1000000000;
     return eval;
 }
 
-int NerdChess::eval::eval_structure(struct NerdChess::board::position board, int piece_map[]) {
-    int eval = 0;
+// Square sets of the piece placement terms
+template<typename F>
+static constexpr NerdChess::bitb::bitboard square_mask(F condition) {
+    NerdChess::bitb::bitboard mask = 0ULL;
+    for(int i = 0; i < 64; ++i)
+        if(condition(i))
+            mask |= 1ULL << i;
+    return mask;
+}
 
-    for(int i = 0; i < 64; ++i) {
-        switch(piece_map[i]) {
-            case EMPTY:
-                break;
-
-            case PAWN: {
-                // Pawns in the center
-                if(NEAR_CENTER(i)) {
-                    eval += 10;
-                    if(IN_CENTER(i))
-                        eval += 10;
-                }
-				// Pawns in the enemy territory
-				if(GET_RANK(i) > 3)
-					eval += 8;
-                break;
-            }
+static constexpr NerdChess::bitb::bitboard near_center = square_mask([](int i) { return NEAR_CENTER(i); });
+static constexpr NerdChess::bitb::bitboard in_center = square_mask([](int i) { return IN_CENTER(i); });
+static constexpr NerdChess::bitb::bitboard white_half = 0x00000000ffffffffULL; // Ranks 8 to 5
+static constexpr NerdChess::bitb::bitboard black_half = ~white_half;
+static constexpr NerdChess::bitb::bitboard white_corners = (1ULL << 56) | (1ULL << 57) | (1ULL << 62) | (1ULL << 63);
+static constexpr NerdChess::bitb::bitboard black_corners = (1ULL << 0) | (1ULL << 1) | (1ULL << 6) | (1ULL << 7);
+static constexpr NerdChess::bitb::bitboard rank_mask(int rank) { return 0xffULL << (rank * 8); }
 
-            case PAWN+_BLACK: {
-                // Pawns in the center
-                if(NEAR_CENTER(i)) {
-                    eval -= 10;
-                    if(IN_CENTER(i))
-                        eval -= 10;
-                }
-				// Pawns in the enemy territory
-				if(GET_RANK(i) > 3)
-					eval += 8;
-                break;
-            }
+// Sums the distance of every pawn from the rank it started on, from the point of view of its color
+template<bool Us, typename B>
+static inline auto rank_sum(B pawns) {
+    using namespace NerdChess::setwise;
+    decltype(popcount(pawns)) sum = {};
+    for(int rank = 1; rank <= 6; ++rank)
+        sum += popcount(pawns & rank_mask(rank)) * (Us ? rank - 1 : 6 - rank);
+    return sum;
+}
 
-            case KNIGHT: {
-                // Knights should be placed in or near the center
-                if(NEAR_CENTER(i))
-                    eval += 15;
-                break;
-            }
+// Counts how often each structure parameter applies (white minus black). Everything is done on whole
+// bitboards, for all pawns of a color at once: north is where white pawns go, south where black pawns go.
+// B is a bitboard with C the int counts of one position, or a setwise::pack with the counts of a whole batch.
+template<typename B, typename C>
+static void structure_features(const B pieces[], C features[]) {
+    using namespace NerdChess::eval;
+    using namespace NerdChess::setwise;
+    const B white = pieces[PAWN], black = pieces[PAWN+_BLACK];
+    const B white_attacks = pawn_attacks<WHITE>(white), black_attacks = pawn_attacks<BLACK>(black);
 
-            case KNIGHT+_BLACK: {
-                // Knights should be placed in or near the center
-                if(NEAR_CENTER(i))
-                    eval -= 15;
-                break;
-            }
+    // Piece placement
+    features[PARAM_PAWN_NEAR_CENTER] += popcount(white & near_center) - popcount(black & near_center);
+    features[PARAM_PAWN_IN_CENTER] += popcount(white & in_center) - popcount(black & in_center);
+    features[PARAM_PAWN_ADVANCED] += popcount(white & white_half) - popcount(black & black_half);
+    features[PARAM_KNIGHT_NEAR_CENTER] += popcount(pieces[KNIGHT] & near_center) - popcount(pieces[KNIGHT+_BLACK] & near_center);
+    features[PARAM_QUEEN_NEAR_CENTER] += popcount(pieces[QUEEN] & near_center) - popcount(pieces[QUEEN+_BLACK] & near_center);
+    features[PARAM_KING_CORNER] += popcount(pieces[KING] & white_corners) - popcount(pieces[KING+_BLACK] & black_corners);
 
-            case QUEEN: {
-                // Queens should not be in the center
-                if(NEAR_CENTER(i))
-                    eval -= 13;
-                break;
-            }
+    // Squares in front of the pawns of a color, and those they could ever attack while advancing
+    const B white_front = north_fill(white >> 8), black_front = south_fill(black << 8);
+    const B white_attack_span = north_fill(white_attacks), black_attack_span = south_fill(black_attacks);
 
-            case QUEEN+_BLACK: {
-                // Queens should not be in the center
-                if(NEAR_CENTER(i))
-                    eval += 13;
-                break;
-            }
+    // Passed: no enemy pawn in front on the same or a neighbouring file, and no own pawn in front either
+    const B white_passed = white & ~(black_front | sides(black_front)) & ~south_fill(white << 8);
+    const B black_passed = black & ~(white_front | sides(white_front)) & ~north_fill(black >> 8);
+    features[PARAM_PASSED_PAWN] += popcount(white_passed) - popcount(black_passed);
+    features[PARAM_PASSED_PAWN_RANK] += rank_sum<WHITE>(white_passed) - rank_sum<BLACK>(black_passed);
 
-            case KING: {
-                // King safely in the corner
-                if(i == 56 || i == 57 || i == 63 || i == 62)
-                    eval += 20;
-                break;
-            }
+    // Isolated: no own pawn on a neighbouring file
+    features[PARAM_ISOLATED_PAWN] += popcount(white & ~sides(file_fill(white))) - popcount(black & ~sides(file_fill(black)));
 
-            case KING+_BLACK: {
-                // King safely in the corner
-                if(i == 0 || i == 1 || i == 6 || i == 7)
-                    eval -= 20;
-                break;
-            }
-        }
-    }
+    // Doubled: behind another own pawn
+    features[PARAM_DOUBLED_PAWN] += popcount(white & south_fill(white << 8)) - popcount(black & north_fill(black >> 8));
 
-    return eval;
+    // Backward: the square in front is attacked by an enemy pawn and no own pawn can ever come up to defend it
+    const B white_backward = (((white >> 8) & black_attacks & ~white_attack_span) << 8) & white;
+    const B black_backward = (((black << 8) & white_attacks & ~black_attack_span) >> 8) & black;
+    features[PARAM_BACKWARD_PAWN] += popcount(white_backward) - popcount(black_backward);
+
+    // Chains: defended by a pawn
+    features[PARAM_PAWN_CHAIN] += popcount(white & white_attacks) - popcount(black & black_attacks);
+
+    // King shield: pawns on the three files around the king, one or two ranks in front of it
+    const B white_king = pieces[KING] & (rank_mask(6) | rank_mask(7));
+    const B black_king = pieces[KING+_BLACK] & (rank_mask(0) | rank_mask(1));
+    const B white_shield = ((white_king | sides(white_king)) >> 8) | ((white_king | sides(white_king)) >> 16);
+    const B black_shield = ((black_king | sides(black_king)) << 8) | ((black_king | sides(black_king)) << 16);
+    features[PARAM_KING_SHIELD] += popcount(white & white_shield) - popcount(black & black_shield);
 }
 
-int NerdChess::eval::middlegame::eval_board_control(struct NerdChess::board::position pos, bool piece_color) {
+int NerdChess::eval::eval_structure(const struct NerdChess::board::position& board) {
+    int features[PARAM_COUNT] = {0};
+    structure_features(board.pieces, features);
     int eval = 0;
-    const int* value_map = piece_color ? board_control_value_map_b : board_control_value_map_w;
-    const NerdChess::bitb::bitboard control_map = board::get_control_map(pos, piece_color);
-    for(int i = 0; i < 64; ++i)
-        if(get_bit(control_map, i) == 1)
-            eval += value_map[i] / 5; // Increases the evaluation based on the value of the squares controlled
+    for(int i = PARAM_PAWN_NEAR_CENTER; i <= PARAM_KING_SHIELD; ++i)
+        eval += features[i] * active_params[i];
     return eval;
 }
 
-int NerdChess::eval::eval_position(struct board::position pos) {
+// Adds up the value of the squares controlled. With AVX2 every bit of the map is spread to a byte, 32 squares at
+// a time, which then picks the weight of its square.
+static inline int control_value(NerdChess::bitb::bitboard control_map, bool piece_color) {
+    const uint8_t* weights = control_weights[piece_color];
+#if defined(__AVX2__)
+    const __m256i map = _mm256_set1_epi64x(control_map);
+    const __m256i bits = _mm256_set1_epi64x(0x8040201008040201ULL);
+    const __m256i low = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i high = _mm256_setr_epi8(4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7);
+    const __m256i low_set = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(map, low), bits), bits);
+    const __m256i high_set = _mm256_cmpeq_epi8(_mm256_and_si256(_mm256_shuffle_epi8(map, high), bits), bits);
+    const __m256i sums = _mm256_add_epi64(_mm256_sad_epu8(_mm256_and_si256(low_set, _mm256_load_si256((const __m256i*)weights)), _mm256_setzero_si256()),
+                                          _mm256_sad_epu8(_mm256_and_si256(high_set, _mm256_load_si256((const __m256i*)(weights + 32))), _mm256_setzero_si256()));
+    const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return (int)(_mm_cvtsi128_si64(half) + _mm_extract_epi64(half, 1));
+#else
+    int value = 0;
+    while(control_map)
+        value += weights[NerdChess::bitb::pop_lsb(control_map)];
+    return value;
+#endif
+}
+
+int NerdChess::eval::middlegame::eval_board_control(const struct NerdChess::board::position& pos, bool piece_color) {
+    return control_value(board::get_control_map(pos, piece_color), piece_color);
+}
+
+#if defined(__AVX2__)
+// get_control_map for a whole batch
+template<bool Us>
+static inline NerdChess::setwise::pack control_map(const NerdChess::setwise::pack pieces[], NerdChess::setwise::pack occupied) {
+    using namespace NerdChess::setwise;
+    constexpr int offset = Us ? _BLACK : 0;
+    return pawn_attacks<Us>(pieces[offset+PAWN])
+        | knight_attacks(pieces[offset+KNIGHT])
+        | slider_attacks(pieces[offset+BISHOP] | pieces[offset+QUEEN], pieces[offset+ROOK] | pieces[offset+QUEEN], occupied)
+        | king_attacks(pieces[offset+KING]);
+}
+#endif
+
+int NerdChess::eval::eval_position(const struct board::position& pos) {
     int eval = 0;
 
-    int piece_type_map[64];
-    for(int i = 0; i < 64; ++i)
-        piece_type_map[i] = NerdChess::board::get_full_piece_type(pos, i);
+    eval += eval_material(pos); // Material
+    eval += (middlegame::eval_board_control(pos, WHITE) - middlegame::eval_board_control(pos, BLACK)) * active_params[PARAM_CONTROL_WEIGHT] / 100; // Board control
+    eval += eval_structure(pos); // Piece structure
 
-    eval += eval_material(pos, piece_type_map); // Material
-    eval += (middlegame::eval_board_control(pos, WHITE) - middlegame::eval_board_control(pos, BLACK)); // Board control
-    eval += eval_structure(pos, piece_type_map); // Piece structure
+    return eval;
+}
 
+
+// Bitbase result on top of the normal evaluation
+static inline int known_result(const struct NerdChess::board::position& pos, bool side_to_move, int eval) {
+    const int result = NerdChess::bitbase::probe(pos, side_to_move);
+    if(result == BITBASE_DRAW)
+        return 0;
+    if(result != BITBASE_UNKNOWN) {
+        // The normal evaluation is kept on top so that the winning side still makes progress
+        const bool white_wins = (result == BITBASE_WIN) == (side_to_move == WHITE);
+        eval += white_wins ? KNOWN_WIN : -KNOWN_WIN;
+    }
     return eval;
 }
+
+// Same as above, but endgames which are covered by the bitbases get their exact result
+int NerdChess::eval::eval_position(const struct board::position& pos, bool side_to_move) {
+    if(bitbase::probe(pos, side_to_move) == BITBASE_DRAW)
+        return 0;
+    return known_result(pos, side_to_move, eval_position(pos));
+}
+
+// With AVX2 the batch is turned into a structure of arrays, with the same bitboard of every position side by
+// side in a pack (one lane per position), and then evaluated like a single position. Only the board control
+// values are added up one position after the other. Without it the positions are simply evaluated in turn.
+void NerdChess::eval::eval_batch(const struct board::position* const positions[], int count, int scores[]) {
+#if !defined(__AVX2__)
+    for(int i = 0; i < count; ++i)
+        scores[i] = eval_position(*positions[i]);
+#else
+    using namespace NerdChess::setwise;
+    const struct board::position* lanes[EVAL_BATCH];
+    for(int i = 0; i < EVAL_BATCH; ++i)
+        lanes[i] = positions[i < count ? i : 0]; // Unused lanes repeat the first position
+    pack pieces[12], occupied;
+    for(int piece = 0; piece < 12; ++piece) {
+        pieces[piece] = pack(lanes[0]->pieces[piece], lanes[1]->pieces[piece], lanes[2]->pieces[piece], lanes[3]->pieces[piece]);
+        occupied |= pieces[piece];
+    }
+
+    pack features[PARAM_COUNT];
+    for(int piece = PAWN; piece <= QUEEN; ++piece)
+        features[PARAM_PAWN_VALUE + piece] = popcount(pieces[piece]) - popcount(pieces[piece + _BLACK]);
+    structure_features(pieces, features);
+    pack score;
+    for(int i = PARAM_PAWN_VALUE; i <= PARAM_KING_SHIELD; ++i)
+        score += features[i] * active_params[i];
+    const pack white_control = control_map<WHITE>(pieces, occupied), black_control = control_map<BLACK>(pieces, occupied);
+
+    for(int i = 0; i < count; ++i) {
+        // A missing king is worth more than 32 bits, see eval_material
+        if(get_winner(*positions[i]) != WINNER_NONE) {
+            scores[i] = eval_position(*positions[i]);
+            continue;
+        }
+        const int control = control_value(white_control[i], WHITE) - control_value(black_control[i], BLACK);
+        scores[i] = (int)score[i] + control * active_params[PARAM_CONTROL_WEIGHT] / 100;
+    }
+#endif
+}
+
+void NerdChess::eval::eval_batch(const struct board::position* const positions[], int count, bool side_to_move, int scores[]) {
+    eval_batch(positions, count, scores);
+    for(int i = 0; i < count; ++i)
+        scores[i] = known_result(*positions[i], side_to_move, scores[i]);
+}
\ No newline at end of file
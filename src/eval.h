@@ -2,8 +2,11 @@
 #define EVAL_H
 
 #include <iostream>
+#include <string>
 #include "position.h"
+#include "bitbase.h"
 
+// Default values of the tunable parameters below
 #define PAWN_VALUE 100
 #define KNIGHT_VALUE 300
 #define BISHOP_VALUE 350
@@ -14,6 +17,11 @@
 #define WINNER_BLACK -1
 #define WINNER_NONE 0
 
+// Added to the evaluation of positions which the bitbases know to be won
+#define KNOWN_WIN 10000
+
+#define EVAL_BATCH 4 // Positions evaluated at once by eval_batch
+
 namespace NerdChess {
 // Maps to determine which squares are more important to control for each team
 extern int board_control_value_map_w[64];
@@ -21,13 +29,69 @@ extern int board_control_value_map_b[64];
 
 void generate_board_control_value_map(int* buf, bool piece_color);
 namespace eval {
-int get_winner(struct board::position pos);
-int eval_material(struct board::position pos, int piece_map[]);
-int eval_structure(struct NerdChess::board::position board, int piece_map[]);
+// Everything the evaluation weighs, kept at runtime so it can be tuned (see tools/tune.cpp) and loaded from a file
+enum param_index {
+    PARAM_PAWN_VALUE,
+    PARAM_KNIGHT_VALUE,
+    PARAM_BISHOP_VALUE,
+    PARAM_ROOK_VALUE,
+    PARAM_QUEEN_VALUE,
+    PARAM_PAWN_NEAR_CENTER,
+    PARAM_PAWN_IN_CENTER, // On top of PARAM_PAWN_NEAR_CENTER
+    PARAM_PAWN_ADVANCED,
+    PARAM_KNIGHT_NEAR_CENTER,
+    PARAM_QUEEN_NEAR_CENTER,
+    PARAM_KING_CORNER,
+    PARAM_PASSED_PAWN,
+    PARAM_PASSED_PAWN_RANK, // Per rank a passed pawn has advanced
+    PARAM_ISOLATED_PAWN,
+    PARAM_DOUBLED_PAWN, // Per pawn behind another one of the same color on its file
+    PARAM_BACKWARD_PAWN,
+    PARAM_PAWN_CHAIN, // Per pawn defended by a pawn
+    PARAM_KING_SHIELD, // Per pawn in the two ranks in front of a king which is still on its first two ranks
+    PARAM_CONTROL_WEIGHT, // Percent of the board control score which is used
+    PARAM_COUNT
+};
+
+extern int params[PARAM_COUNT];
+// What the evaluation on this thread uses, params unless a search set those of its config (engine::config::params)
+extern thread_local const int* active_params;
+extern const char* param_names[PARAM_COUNT];
+extern const int param_divisors[PARAM_COUNT]; // The evaluation adds feature * param / divisor
+
+// Lines of "name value" into values, unknown names are an error. Parameters missing from the file keep their value.
+bool load_params(const std::string& path, int* values = params);
+bool save_params(const std::string& path);
+// Makes the evaluation on this thread use values (unless nullptr) until it goes out of scope
+struct params_scope {
+    explicit params_scope(const int* values) : saved(active_params) {
+        if(values)
+            active_params = values;
+    }
+    ~params_scope() { active_params = saved; }
+    params_scope(const params_scope&) = delete;
+    params_scope& operator=(const params_scope&) = delete;
+
+private:
+    const int* saved;
+};
+
+// What every parameter is multiplied with in the evaluation (white minus black), so that
+// eval_position(pos) == sum of features[i] * params[i] / param_divisors[i] (up to rounding)
+void eval_features(const struct board::position& pos, int features[PARAM_COUNT]);
+
+int get_winner(const struct board::position& pos);
+int eval_material(const struct board::position& pos);
+int eval_structure(const struct NerdChess::board::position& board);
 namespace middlegame {
-int eval_board_control(struct board::position pos, bool piece_color);
+int eval_board_control(const struct board::position& pos, bool piece_color);
 } // namespace middlegame
-int eval_position(struct board::position pos);
+int eval_position(const struct board::position& pos);
+int eval_position(const struct board::position& pos, bool side_to_move);
+// Same as eval_position for up to EVAL_BATCH positions, which are evaluated side by side (with AVX2 in one
+// register each) instead of one after the other
+void eval_batch(const struct board::position* const positions[], int count, int scores[]);
+void eval_batch(const struct board::position* const positions[], int count, bool side_to_move, int scores[]);
 } // namespace eval
 } // namespace NerdChess
 
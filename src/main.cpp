@@ -1,5 +1,6 @@
 #include <iostream>
 #include <Windows.h>
+#include <thread>
 #include "engine.h"
 #include "opening.h"
 
@@ -20,6 +21,9 @@ int main(int argc, char* argv[]) {
 	NerdChess::generate_board_control_value_map(NerdChess::board_control_value_map_w, WHITE);
 	NerdChess::generate_board_control_value_map(NerdChess::board_control_value_map_b, BLACK);
 	NerdChess::opening::init_opening_book();
+	NerdChess::movegen::init();
+	NerdChess::bitbase::init({"KPK", "KRK", "KQK", "KQKR", "KBNK"}, std::thread::hardware_concurrency(), "NerdChess.bb");
+	NerdChess::engine::tt::default_table.resize(TT_DEFAULT_MB, std::thread::hardware_concurrency());
 
 	// Initialize board
 	struct NerdChess::board::position board = NerdChess::board::get_empty_position();
@@ -120,11 +124,16 @@ int main(int argc, char* argv[]) {
 			NerdChess::board::move_piece(board, book_move[0], book_move[1]);
 		}
 		catch(const std::exception& e) {
+			NerdChess::engine::stats::clear();
 			struct NerdChess::engine::engine_eval eval = NerdChess::engine::minimax(board, false, -INT_MAX, INT_MAX, 4); // Actual thinking
+			NerdChess::engine::stats::merge();
 			NerdChess::board::move_piece(board, eval.best_move[0], eval.best_move[1]);
 
 			system("cls");
 			NerdChess::board::debug::print_board(board);
+#ifdef NERDCHESS_STATS
+			std::cout << NerdChess::engine::stats::to_json(NerdChess::engine::stats::get()) << "\n";
+#endif
 		}
 	}
 
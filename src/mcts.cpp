@@ -0,0 +1,302 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <random>
+#include <math.h>
+#include "mcts.h"
+
+// One search: the shared tree and what every thread needs to know to stop
+struct tree {
+    const struct NerdChess::engine::config* cfg;
+    struct NerdChess::board::position root;
+    bool side;
+    std::unique_ptr<struct NerdChess::engine::mcts::node[]> nodes; // Left uninitialized, a node is set up when it is handed out
+    uint32_t capacity;
+    std::atomic<uint32_t> used;
+    std::atomic<bool> full; // An allocation failed, no more leaves are expanded
+    std::atomic<bool> stopped;
+    const std::atomic<bool>* stop; // May be nullptr
+    bool timed;
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t max_playouts;
+    std::vector<uint64_t> game_keys; // Game positions before the root which can still repeat
+};
+
+// Keys of the positions of the current playout (root first), for repetitions
+struct playout_path {
+    uint32_t nodes[MAX_PLY + 1];
+    uint64_t keys[MAX_PLY + 1];
+    int length;
+};
+
+static inline void init_node(struct NerdChess::engine::mcts::node& n, NerdChess::movegen::move move, float prior) {
+    n.visits.store(0, std::memory_order_relaxed);
+    n.virtual_loss.store(0, std::memory_order_relaxed);
+    n.value.store(0, std::memory_order_relaxed);
+    n.first_child = 0;
+    n.child_count = 0;
+    n.state.store(MCTS_LEAF, std::memory_order_relaxed);
+    n.move = move;
+    n.prior = prior;
+}
+
+// Index of count consecutive nodes, or UINT32_MAX if the pool is used up
+static inline uint32_t allocate(struct tree& t, uint32_t count) {
+    if(t.used.load(std::memory_order_relaxed) + count > t.capacity)
+        return UINT32_MAX;
+    const uint32_t first = t.used.fetch_add(count, std::memory_order_relaxed);
+    return first + count <= t.capacity ? first : UINT32_MAX;
+}
+
+// Winning chances of the side to move, from a white-positive evaluation in centipawns
+static inline double to_probability(int eval, bool side) {
+    const double white = 1.0 / (1.0 + exp(-eval * M_LN10 / MCTS_EVAL_SCALE));
+    return side == WHITE ? white : 1.0 - white;
+}
+
+static inline int from_probability(double p, bool side) {
+    p = std::min(std::max(p, 0.001), 0.999);
+    const int eval = (int)lround(-MCTS_EVAL_SCALE * log10(1.0 / p - 1.0));
+    return side == WHITE ? eval : -eval;
+}
+
+// Repetition (of any earlier position with the same side to move) or fifty-move rule
+static bool is_draw(const struct tree& t, const struct NerdChess::board::position& pos, const struct playout_path& path) {
+    if(pos.halfmove_clock >= 100)
+        return true;
+    for(int i = path.length - 3; i >= 0 && i >= path.length - 1 - pos.halfmove_clock; i -= 2) {
+        if(path.keys[i] == pos.key)
+            return true;
+    }
+    // Game positions before the root, where the parity is counted from the root
+    const int back = path.length - 1; // Plies between the root and pos
+    for(int i = (int)t.game_keys.size() - 1 - ((back + 1) % 2); i >= 0 && (int)t.game_keys.size() - i + back <= pos.halfmove_clock; i -= 2) {
+        if(t.game_keys[i] == pos.key)
+            return true;
+    }
+    return false;
+}
+
+// PUCT: average result plus the exploration bonus. Virtual losses count as visits which were lost. A child
+// which wasn't visited yet is assumed to be as good as its parent.
+static uint32_t select_child(const struct tree& t, const struct NerdChess::engine::mcts::node& parent) {
+    const uint32_t parent_visits = parent.visits.load(std::memory_order_relaxed);
+    const double sqrt_visits = sqrt((double)std::max<uint32_t>(1, parent_visits + parent.virtual_loss.load(std::memory_order_relaxed)));
+    const double parent_value = parent_visits ? 1.0 - (double)parent.value.load(std::memory_order_relaxed) / ((double)MCTS_VALUE_SCALE * parent_visits) : 0.5;
+    const double cpuct = t.cfg->mcts_cpuct / 100.0;
+    uint32_t best = parent.first_child;
+    double best_score = -1e9;
+    for(uint32_t i = parent.first_child; i < parent.first_child + parent.child_count; ++i) {
+        const struct NerdChess::engine::mcts::node& child = t.nodes[i];
+        const uint32_t visits = child.visits.load(std::memory_order_relaxed) + child.virtual_loss.load(std::memory_order_relaxed);
+        const double q = visits ? (double)child.value.load(std::memory_order_relaxed) / ((double)MCTS_VALUE_SCALE * visits) : parent_value;
+        const double score = q + cpuct * child.prior * sqrt_visits / (1.0 + visits);
+        if(score > best_score) {
+            best_score = score;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Adds the children of n, with priors from a softmax over the material the moves win (see engine::see)
+static void expand(struct tree& t, struct NerdChess::engine::mcts::node& n, const struct NerdChess::board::position& pos, const struct NerdChess::movegen::move_list& moves) {
+    const uint32_t first = allocate(t, moves.size);
+    if(first == UINT32_MAX) {
+        t.full.store(true, std::memory_order_relaxed);
+        n.state.store(MCTS_LEAF, std::memory_order_release); // Out of nodes, stays a leaf
+        return;
+    }
+    double priors[MAX_MOVES], sum = 0.0;
+    for(int i = 0; i < moves.size; ++i) {
+        const int gain = NerdChess::movegen::is_capture(pos, moves.moves[i]) ? NerdChess::engine::see(pos, moves.moves[i]) : 0;
+        priors[i] = exp(std::min(gain, 1000) / 100.0);
+        sum += priors[i];
+    }
+    for(int i = 0; i < moves.size; ++i)
+        init_node(t.nodes[first + i], moves.moves[i], (float)(priors[i] / sum));
+    n.first_child = first;
+    n.child_count = moves.size;
+    n.state.store(MCTS_EXPANDED, std::memory_order_release);
+}
+
+// Winning chances of the side to move at a leaf: the static evaluation, after cfg->mcts_playout random moves
+static double evaluate_leaf(const struct tree& t, const struct NerdChess::board::position& leaf, bool side, std::mt19937_64& rng) {
+    struct NerdChess::board::position pos = leaf;
+    for(int ply = 0; ply < t.cfg->mcts_playout; ++ply) {
+        struct NerdChess::movegen::move_list moves;
+        NerdChess::movegen::generate(pos, side, moves);
+        if(moves.size == 0)
+            return NerdChess::movegen::in_check(pos, side) ? (ply % 2 ? 1.0 : 0.0) : 0.5;
+        NerdChess::movegen::make_move(pos, moves.moves[rng() % moves.size]);
+        side = !side;
+        if(pos.halfmove_clock >= 100)
+            return 0.5;
+    }
+    const int eval = t.cfg->use_bitbases ? NerdChess::eval::eval_position(pos, side) : NerdChess::eval::eval_position(pos);
+    // Back to the side to move at the leaf
+    const double p = to_probability(eval, side);
+    return t.cfg->mcts_playout % 2 ? 1.0 - p : p;
+}
+
+// count is the number of playouts of the calling thread, the clock is only looked at every 16
+static inline bool out_of_time(struct tree& t, uint64_t count) {
+    if((t.stop && t.stop->load(std::memory_order_relaxed)) || t.nodes[0].visits.load(std::memory_order_relaxed) >= t.max_playouts
+       || (t.timed && (count & 15) == 0 && std::chrono::steady_clock::now() >= t.deadline))
+        t.stopped.store(true, std::memory_order_relaxed);
+    return t.stopped.load(std::memory_order_relaxed);
+}
+
+// One playout: down to a leaf, evaluate or expand it, and back up with the result
+static void playout(struct tree& t, std::mt19937_64& rng) {
+    struct NerdChess::board::position pos = t.root;
+    bool side = t.side;
+    struct playout_path path;
+    path.length = 1;
+    path.nodes[0] = 0;
+    path.keys[0] = pos.key;
+    t.nodes[0].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+
+    double value = -1.0; // For the side to move at the end of the path, -1 while unknown
+    while(t.nodes[path.nodes[path.length - 1]].state.load(std::memory_order_acquire) == MCTS_EXPANDED) {
+        const uint32_t child = select_child(t, t.nodes[path.nodes[path.length - 1]]);
+        t.nodes[child].virtual_loss.fetch_add(1, std::memory_order_relaxed);
+        NerdChess::movegen::make_move(pos, t.nodes[child].move);
+        side = !side;
+        path.nodes[path.length] = child;
+        path.keys[path.length] = pos.key;
+        path.length++;
+        if(is_draw(t, pos, path)) {
+            value = 0.5;
+            break;
+        }
+        if(path.length > MAX_PLY)
+            break;
+    }
+
+    struct NerdChess::engine::mcts::node& leaf = t.nodes[path.nodes[path.length - 1]];
+    if(value < 0.0) {
+        struct NerdChess::movegen::move_list moves;
+        NerdChess::movegen::generate(pos, side, moves);
+        if(moves.size == 0) {
+            value = NerdChess::movegen::in_check(pos, side) ? 0.0 : 0.5;
+        } else {
+            uint8_t expected = MCTS_LEAF;
+            if(path.length <= MAX_PLY && !t.full.load(std::memory_order_relaxed) && leaf.visits.load(std::memory_order_relaxed) + 1 >= MCTS_EXPAND_VISITS
+               && leaf.state.compare_exchange_strong(expected, MCTS_EXPANDING, std::memory_order_acquire))
+                expand(t, leaf, pos, moves);
+            value = evaluate_leaf(t, pos, side, rng);
+        }
+    }
+
+    // Every node holds the result for the side which moved into it, the opposite of the side to move there
+    for(int i = path.length - 1; i >= 0; --i) {
+        struct NerdChess::engine::mcts::node& n = t.nodes[path.nodes[i]];
+        value = 1.0 - value;
+        n.value.fetch_add((int64_t)(value * MCTS_VALUE_SCALE), std::memory_order_relaxed);
+        n.visits.fetch_add(1, std::memory_order_relaxed);
+        n.virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+// The most visited child, or UINT32_MAX for a leaf
+static uint32_t most_visited(const struct tree& t, const struct NerdChess::engine::mcts::node& n) {
+    if(n.state.load(std::memory_order_acquire) != MCTS_EXPANDED)
+        return UINT32_MAX;
+    uint32_t best = UINT32_MAX, best_visits = 0;
+    for(uint32_t i = n.first_child; i < n.first_child + n.child_count; ++i) {
+        const uint32_t visits = t.nodes[i].visits.load(std::memory_order_relaxed);
+        if(visits > best_visits) {
+            best_visits = visits;
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void fill_info(const struct tree& t, struct NerdChess::engine::search_info& info, std::chrono::steady_clock::time_point start) {
+    info.pv.clear();
+    info.score = 0;
+    uint32_t n = most_visited(t, t.nodes[0]);
+    if(n != UINT32_MAX) {
+        const struct NerdChess::engine::mcts::node& best = t.nodes[n];
+        info.score = from_probability((double)best.value.load() / ((double)MCTS_VALUE_SCALE * best.visits.load()), t.side);
+    }
+    while(n != UINT32_MAX && info.pv.size() < MAX_PLY) {
+        info.pv.push_back(t.nodes[n].move);
+        n = most_visited(t, t.nodes[n]);
+    }
+    info.depth = info.pv.size();
+    info.nodes = t.nodes[0].visits.load(std::memory_order_relaxed);
+    info.time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    info.lines.assign(1, {info.score, info.pv});
+}
+
+// Playouts until the search is stopped. Thread 0 reports the progress whenever the number of playouts has doubled.
+static void worker(struct tree& t, int index, const struct NerdChess::engine::search_control* control, std::chrono::steady_clock::time_point start) {
+    const NerdChess::eval::params_scope scope(t.cfg->params);
+    std::mt19937_64 rng(0x9e3779b97f4a7c15ULL * (index + 1));
+    uint64_t next_report = 1024, count = 0;
+    while(!out_of_time(t, count++)) {
+        playout(t, rng);
+        if(index == 0 && control && control->on_progress && t.nodes[0].visits.load(std::memory_order_relaxed) >= next_report) {
+            struct NerdChess::engine::search_info progress;
+            fill_info(t, progress, start);
+            control->on_progress(progress);
+            next_report *= 2;
+        }
+    }
+}
+
+struct NerdChess::engine::engine_eval NerdChess::engine::mcts::think(const struct board::position& root, bool side, const struct search_limits& limits, const struct config& cfg,
+                                                                     struct search_info* info, const struct search_control* control, const std::vector<uint64_t>* history) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    struct engine_eval best = {0, {-1, -1}, NO_MOVE};
+    struct tree t;
+    t.cfg = &cfg;
+    t.root = root;
+    t.root.side = side;
+    t.root.key = board::compute_key(t.root);
+    t.side = side;
+    t.capacity = (uint32_t)std::min<uint64_t>((uint64_t)std::max(1, cfg.mcts_pool_mb) * 1024 * 1024 / sizeof(struct node), UINT32_MAX - MAX_MOVES);
+    t.nodes.reset(new struct node[t.capacity]);
+    t.used = 1;
+    t.full = false;
+    t.stopped = false;
+    t.stop = control ? control->stop : nullptr;
+    t.timed = limits.time_ms > 0;
+    t.deadline = start + std::chrono::milliseconds(limits.time_ms);
+    t.max_playouts = t.timed ? UINT64_MAX : (uint64_t)std::max(1, limits.depth) * MCTS_PLAYOUTS_PER_DEPTH;
+    if(history) {
+        const size_t count = std::min<size_t>(history->size(), root.halfmove_clock);
+        t.game_keys.assign(history->end() - count, history->end());
+    }
+    init_node(t.nodes[0], NO_MOVE, 1.0f);
+
+    struct movegen::move_list moves;
+    movegen::generate(t.root, side, moves);
+    if(moves.size == 0) {
+        if(info)
+            *info = {0, 0, {}, 0, 0, {}};
+        return best;
+    }
+
+    // The calling thread is thread 0
+    std::vector<std::thread> threads;
+    for(int i = 1; i < cfg.threads; ++i)
+        threads.emplace_back(worker, std::ref(t), i, control, start);
+    worker(t, 0, control, start);
+    for(std::thread& thread : threads)
+        thread.join();
+
+    struct search_info result;
+    fill_info(t, result, start);
+    best.move = result.pv.empty() ? moves.moves[0] : result.pv[0];
+    best.eval = result.score;
+    best.best_move[0] = movegen::move_from(best.move);
+    best.best_move[1] = movegen::move_to(best.move);
+    if(info)
+        *info = result;
+    return best;
+}
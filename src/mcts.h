@@ -0,0 +1,55 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include "engine.h"
+
+#define MCTS_DEFAULT_POOL_MB 256
+#define MCTS_PLAYOUTS_PER_DEPTH 10000 // Playouts per ply of search_limits::depth when there is no time limit
+#define MCTS_EXPAND_VISITS 2 // A leaf gets children on its second visit, the first one only evaluates it
+#define MCTS_VALUE_SCALE 65536 // A win in node::value
+#define MCTS_EVAL_SCALE 400 // Centipawns for 10 to 1 odds of winning
+
+// node::state
+#define MCTS_LEAF 0
+#define MCTS_EXPANDING 1 // Another thread is adding the children
+#define MCTS_EXPANDED 2
+
+namespace NerdChess {
+namespace engine {
+namespace mcts {
+// Monte Carlo tree search with PUCT selection, as the second search mode next to alpha-beta (see
+// config::mode). Every playout walks down the tree, picking the child with the best sum of its average
+// result and an exploration bonus which grows with its prior and shrinks with its visits, until it reaches
+// a leaf. The leaf is evaluated, by eval::eval_position or after a short random playout, and the result is
+// added to every node on the way back.
+//
+// config::threads threads build one tree together without locks: the node statistics are atomics, each
+// thread counts a virtual loss on the nodes it is below so that the others spread out to other lines, and
+// whichever thread first marks a leaf as MCTS_EXPANDING adds its children. Nodes come from a pool which is
+// allocated once per search, children are one consecutive block in it. Once the pool is used up the leaves
+// are still evaluated but no longer expanded.
+struct node {
+    std::atomic<uint32_t> visits;
+    std::atomic<uint32_t> virtual_loss; // Threads currently below this node
+    std::atomic<int64_t> value; // Sum of the results for the side which made move, MCTS_VALUE_SCALE per win
+    uint32_t first_child; // Index in the pool, only valid once state is MCTS_EXPANDED
+    uint16_t child_count;
+    std::atomic<uint8_t> state;
+    movegen::move move;
+    float prior; // Probability that move is the best one, before any visits
+};
+
+static_assert(sizeof(struct node) == 32, "mcts node must be 32 bytes");
+
+// Same interface as engine::think: the most visited root move is played. search_info::nodes counts the
+// playouts and depth is the length of the principal variation (the most visited line).
+struct engine_eval think(const struct board::position& root, bool side, const struct search_limits& limits, const struct config& cfg, struct search_info* info,
+                         const struct search_control* control = nullptr, const std::vector<uint64_t>* history = nullptr);
+} // namespace mcts
+} // namespace engine
+} // namespace NerdChess
+
+#endif
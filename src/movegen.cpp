@@ -0,0 +1,377 @@
+#include <iostream>
+#include "movegen.h"
+
+using namespace NerdChess::bitb;
+
+NerdChess::bitb::bitboard NerdChess::movegen::knight_attacks[64];
+NerdChess::bitb::bitboard NerdChess::movegen::king_attacks[64];
+NerdChess::bitb::bitboard NerdChess::movegen::pawn_attacks[2][64];
+NerdChess::bitb::bitboard NerdChess::movegen::between[64][64];
+NerdChess::bitb::bitboard NerdChess::movegen::line[64][64];
+
+// Rays from every square in the 8 directions. The first 4 directions increase the square index
+// (the nearest blocker is the lowest bit), the last 4 decrease it (the nearest blocker is the highest bit).
+static NerdChess::bitb::bitboard rays[8][64];
+static const int ray_df[8] = {1, 0, 1, -1, -1, 0, -1, 1};
+static const int ray_dr[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+static inline bool on_board(int file, int rank) {
+	return file >= 0 && file < 8 && rank >= 0 && rank < 8;
+}
+
+void NerdChess::movegen::init() {
+	const int knight_df[8] = {1, -1, 2, -2, 2, -2, 1, -1};
+	const int knight_dr[8] = {-2, -2, -1, -1, 1, 1, 2, 2};
+
+	for(int square = 0; square < 64; ++square) {
+		const int file = GET_FILE(square);
+		const int rank = GET_RANK(square);
+
+		knight_attacks[square] = 0ULL;
+		king_attacks[square] = 0ULL;
+		pawn_attacks[WHITE][square] = 0ULL;
+		pawn_attacks[BLACK][square] = 0ULL;
+		for(int i = 0; i < 8; ++i) {
+			if(on_board(file + knight_df[i], rank + knight_dr[i]))
+				set_bit(knight_attacks[square], (rank + knight_dr[i]) * 8 + file + knight_df[i]);
+			if(on_board(file + ray_df[i], rank + ray_dr[i]))
+				set_bit(king_attacks[square], (rank + ray_dr[i]) * 8 + file + ray_df[i]);
+		}
+		for(int df = -1; df <= 1; df += 2) {
+			if(on_board(file + df, rank - 1))
+				set_bit(pawn_attacks[WHITE][square], square - 8 + df);
+			if(on_board(file + df, rank + 1))
+				set_bit(pawn_attacks[BLACK][square], square + 8 + df);
+		}
+
+		for(int dir = 0; dir < 8; ++dir) {
+			rays[dir][square] = 0ULL;
+			for(int f = file + ray_df[dir], r = rank + ray_dr[dir]; on_board(f, r); f += ray_df[dir], r += ray_dr[dir])
+				set_bit(rays[dir][square], r * 8 + f);
+		}
+	}
+
+	for(int a = 0; a < 64; ++a) {
+		for(int b = 0; b < 64; ++b) {
+			between[a][b] = 0ULL;
+			line[a][b] = 0ULL;
+		}
+		for(int dir = 0; dir < 8; ++dir) {
+			bitboard ray = rays[dir][a];
+			while(ray) {
+				const int b = pop_lsb(ray);
+				// Squares before b on the ray from a
+				between[a][b] = rays[dir][a] & ~rays[dir][b] & ~(1ULL << b);
+				line[a][b] = rays[dir][a] | rays[(dir + 4) % 8][a] | (1ULL << a);
+			}
+		}
+	}
+}
+
+static inline NerdChess::bitb::bitboard ray_attacks(int dir, int square, NerdChess::bitb::bitboard occupied) {
+	const bitboard ray = rays[dir][square];
+	const bitboard blockers = ray & occupied;
+	if(!blockers)
+		return ray;
+	const int blocker = dir < 4 ? lsb(blockers) : msb(blockers);
+	return ray ^ rays[dir][blocker];
+}
+
+NerdChess::bitb::bitboard NerdChess::movegen::bishop_attacks(int square, bitboard occupied) {
+	return ray_attacks(2, square, occupied) | ray_attacks(3, square, occupied) | ray_attacks(6, square, occupied) | ray_attacks(7, square, occupied);
+}
+
+NerdChess::bitb::bitboard NerdChess::movegen::rook_attacks(int square, bitboard occupied) {
+	return ray_attacks(0, square, occupied) | ray_attacks(1, square, occupied) | ray_attacks(4, square, occupied) | ray_attacks(5, square, occupied);
+}
+
+// Pieces of both colors which attack the square
+NerdChess::bitb::bitboard NerdChess::movegen::attackers_to(const struct board::position& pos, int square, bitboard occupied) {
+	return (pawn_attacks[BLACK][square] & pos.pieces[PAWN])
+		| (pawn_attacks[WHITE][square] & pos.pieces[PAWN+_BLACK])
+		| (knight_attacks[square] & (pos.pieces[KNIGHT] | pos.pieces[KNIGHT+_BLACK]))
+		| (king_attacks[square] & (pos.pieces[KING] | pos.pieces[KING+_BLACK]))
+		| (bishop_attacks(square, occupied) & (pos.pieces[BISHOP] | pos.pieces[BISHOP+_BLACK] | pos.pieces[QUEEN] | pos.pieces[QUEEN+_BLACK]))
+		| (rook_attacks(square, occupied) & (pos.pieces[ROOK] | pos.pieces[ROOK+_BLACK] | pos.pieces[QUEEN] | pos.pieces[QUEEN+_BLACK]));
+}
+
+template<bool Us>
+static inline NerdChess::bitb::bitboard side_pieces(const struct NerdChess::board::position& pos) {
+	constexpr int offset = Us ? _BLACK : 0;
+	return pos.pieces[PAWN+offset] | pos.pieces[KNIGHT+offset] | pos.pieces[BISHOP+offset] | pos.pieces[ROOK+offset] | pos.pieces[QUEEN+offset] | pos.pieces[KING+offset];
+}
+
+template<bool Us>
+bool NerdChess::movegen::in_check(const struct board::position& pos) {
+	const bitboard king = pos.pieces[KING + (Us ? _BLACK : 0)];
+	if(!king)
+		return false;
+	const bitboard occupied = side_pieces<WHITE>(pos) | side_pieces<BLACK>(pos);
+	return attackers_to(pos, lsb(king), occupied) & side_pieces<!Us>(pos);
+}
+
+template bool NerdChess::movegen::in_check<WHITE>(const struct board::position&);
+template bool NerdChess::movegen::in_check<BLACK>(const struct board::position&);
+
+bool NerdChess::movegen::in_check(const struct board::position& pos, bool side) {
+	return side ? in_check<BLACK>(pos) : in_check<WHITE>(pos);
+}
+
+static inline void add_moves(struct NerdChess::movegen::move_list& list, int from, NerdChess::bitb::bitboard targets) {
+	while(targets)
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, pop_lsb(targets));
+}
+
+static inline void add_pawn_move(struct NerdChess::movegen::move_list& list, int from, int to, bool promotion) {
+	if(promotion) {
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, to, QUEEN);
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, to, ROOK);
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, to, BISHOP);
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, to, KNIGHT);
+	} else {
+		list.moves[list.size++] = NerdChess::movegen::make_move(from, to);
+	}
+}
+
+template<bool Us, NerdChess::movegen::gen_type Type>
+void NerdChess::movegen::generate(const struct board::position& pos, struct move_list& list) {
+	constexpr int us = Us ? _BLACK : 0;
+	constexpr int them = Us ? 0 : _BLACK;
+	constexpr int up = (Us == WHITE) ? -8 : 8;
+	constexpr int start_rank = (Us == WHITE) ? 6 : 1;
+	constexpr int last_rank = (Us == WHITE) ? 0 : 7;
+
+	list.size = 0;
+	if(!pos.pieces[KING+us])
+		return;
+
+	const bitboard own = side_pieces<Us>(pos);
+	const bitboard enemy = side_pieces<!Us>(pos);
+	const bitboard occupied = own | enemy;
+	const int king = lsb(pos.pieces[KING+us]);
+	const bitboard checkers = attackers_to(pos, king, occupied) & enemy;
+	const bitboard enemy_diagonal = pos.pieces[BISHOP+them] | pos.pieces[QUEEN+them];
+	const bitboard enemy_straight = pos.pieces[ROOK+them] | pos.pieces[QUEEN+them];
+	const bitboard type_mask = Type == GEN_ALL ? ~own : (Type == GEN_CAPTURES ? enemy : ~occupied); // Where pieces other than pawns may go
+
+	// King moves (the king is removed from the occupancy so that it can't hide behind itself on a checking line)
+	bitboard targets = king_attacks[king] & type_mask;
+	while(targets) {
+		const int to = pop_lsb(targets);
+		if(!(attackers_to(pos, to, occupied ^ (1ULL << king)) & enemy))
+			list.moves[list.size++] = make_move(king, to);
+	}
+
+	// In double check only the king can move
+	if(popcount(checkers) > 1)
+		return;
+
+	// Squares the other pieces may move to: anywhere when not in check, otherwise capture the checker or block
+	const bitboard check_mask = checkers ? (between[king][lsb(checkers)] | checkers) : ~0ULL;
+
+	// Own pieces which are the only piece between an enemy slider and our king
+	bitboard pinned = 0ULL;
+	bitboard snipers = (bishop_attacks(king, 0ULL) & enemy_diagonal) | (rook_attacks(king, 0ULL) & enemy_straight);
+	while(snipers) {
+		const bitboard blockers = between[king][pop_lsb(snipers)] & occupied;
+		if(popcount(blockers) == 1)
+			pinned |= blockers & own;
+	}
+
+	// Knights (a pinned knight can never move)
+	bitboard pieces = pos.pieces[KNIGHT+us] & ~pinned;
+	while(pieces) {
+		const int from = pop_lsb(pieces);
+		add_moves(list, from, knight_attacks[from] & type_mask & check_mask);
+	}
+
+	// Sliders (pinned ones may only move along the pin)
+	pieces = pos.pieces[BISHOP+us] | pos.pieces[QUEEN+us];
+	while(pieces) {
+		const int from = pop_lsb(pieces);
+		bitboard moves = bishop_attacks(from, occupied) & type_mask & check_mask;
+		if(get_bit(pinned, from))
+			moves &= line[king][from];
+		add_moves(list, from, moves);
+	}
+	pieces = pos.pieces[ROOK+us] | pos.pieces[QUEEN+us];
+	while(pieces) {
+		const int from = pop_lsb(pieces);
+		bitboard moves = rook_attacks(from, occupied) & type_mask & check_mask;
+		if(get_bit(pinned, from))
+			moves &= line[king][from];
+		add_moves(list, from, moves);
+	}
+
+	// Pawns
+	const int en_pessant = pos.en_pessant_square(Us);
+	pieces = pos.pieces[PAWN+us];
+	while(pieces) {
+		const int from = pop_lsb(pieces);
+		const bitboard allowed = get_bit(pinned, from) ? (line[king][from] & check_mask) : check_mask;
+		const int forward = from + up;
+		const bool promotion = GET_RANK(forward) == last_rank;
+
+		// Promotions count as captures, the other pawn pushes are quiet moves
+		if(!get_bit(occupied, from + up)) {
+			if(get_bit(allowed, from + up) && (promotion ? Type != GEN_QUIETS : Type != GEN_CAPTURES))
+				add_pawn_move(list, from, from + up, promotion); // 1 square forward
+			if(Type != GEN_CAPTURES && GET_RANK(from) == start_rank && !get_bit(occupied, from + 2*up) && get_bit(allowed, from + 2*up))
+				add_pawn_move(list, from, from + 2*up, false); // 2 squares forward
+		}
+
+		if(Type == GEN_QUIETS)
+			continue;
+
+		bitboard captures = pawn_attacks[Us][from] & enemy & allowed;
+		while(captures)
+			add_pawn_move(list, from, pop_lsb(captures), promotion);
+
+		// En pessant is rare enough to simply check the king after making the capture on the occupancy
+		if(en_pessant >= 0 && get_bit(pawn_attacks[Us][from], en_pessant)) {
+			const int captured = en_pessant - up;
+			const bitboard after = (occupied ^ (1ULL << from) ^ (1ULL << captured)) | (1ULL << en_pessant);
+			const bool exposed = (bishop_attacks(king, after) & enemy_diagonal)
+				|| (rook_attacks(king, after) & enemy_straight)
+				|| (knight_attacks[king] & pos.pieces[KNIGHT+them])
+				|| (pawn_attacks[Us][king] & pos.pieces[PAWN+them] & ~(1ULL << captured));
+			if(!exposed)
+				list.moves[list.size++] = make_move(from, en_pessant);
+		}
+	}
+
+	// Castling (the king may not be in check, pass through or land on an attacked square)
+	if(Type != GEN_CAPTURES && !checkers) {
+		if(pos.can_castle(Us, 0) && get_bit(pos.pieces[ROOK+us], king + 3)
+			&& !get_bit(occupied, king + 1) && !get_bit(occupied, king + 2)
+			&& !(attackers_to(pos, king + 1, occupied) & enemy) && !(attackers_to(pos, king + 2, occupied) & enemy))
+			list.moves[list.size++] = make_move(king, king + 2); // King-side castle
+		if(pos.can_castle(Us, 1) && get_bit(pos.pieces[ROOK+us], king - 4)
+			&& !get_bit(occupied, king - 1) && !get_bit(occupied, king - 2) && !get_bit(occupied, king - 3)
+			&& !(attackers_to(pos, king - 1, occupied) & enemy) && !(attackers_to(pos, king - 2, occupied) & enemy))
+			list.moves[list.size++] = make_move(king, king - 2); // Queen-side castle
+	}
+}
+
+template void NerdChess::movegen::generate<WHITE, NerdChess::movegen::GEN_ALL>(const struct board::position&, struct move_list&);
+template void NerdChess::movegen::generate<WHITE, NerdChess::movegen::GEN_CAPTURES>(const struct board::position&, struct move_list&);
+template void NerdChess::movegen::generate<WHITE, NerdChess::movegen::GEN_QUIETS>(const struct board::position&, struct move_list&);
+template void NerdChess::movegen::generate<BLACK, NerdChess::movegen::GEN_ALL>(const struct board::position&, struct move_list&);
+template void NerdChess::movegen::generate<BLACK, NerdChess::movegen::GEN_CAPTURES>(const struct board::position&, struct move_list&);
+template void NerdChess::movegen::generate<BLACK, NerdChess::movegen::GEN_QUIETS>(const struct board::position&, struct move_list&);
+
+void NerdChess::movegen::generate(const struct board::position& pos, bool side, struct move_list& list) {
+	if(side)
+		generate<BLACK>(pos, list);
+	else
+		generate<WHITE>(pos, list);
+}
+
+// Checks a move which did not come from the move generator (e.g. a killer move or a move from the
+// hash table, which may belong to a different position): the piece has to be able to make the move
+// and the own king may not be left in check.
+template<bool Us>
+bool NerdChess::movegen::is_legal(const struct board::position& pos, move m) {
+	constexpr int us = Us ? _BLACK : 0;
+	constexpr int up = (Us == WHITE) ? -8 : 8;
+	constexpr int start_rank = (Us == WHITE) ? 6 : 1;
+	constexpr int last_rank = (Us == WHITE) ? 0 : 7;
+	const int from = move_from(m);
+	const int to = move_to(m);
+	const bitboard own = side_pieces<Us>(pos);
+	const bitboard enemy = side_pieces<!Us>(pos);
+	const bitboard occupied = own | enemy;
+
+	if(m == NO_MOVE || !get_bit(own, from) || get_bit(own, to))
+		return false;
+
+	int piece = PAWN;
+	while(!get_bit(pos.pieces[piece+us], from))
+		piece++;
+	if(move_promotion(m) && (piece != PAWN || GET_RANK(to) != last_rank || move_promotion(m) < KNIGHT || move_promotion(m) > QUEEN))
+		return false;
+
+	switch(piece) {
+		case PAWN: {
+			if(GET_RANK(to) == last_rank && !move_promotion(m))
+				return false;
+			const bool push = to == from + up && !get_bit(occupied, to);
+			const bool double_push = to == from + 2*up && GET_RANK(from) == start_rank && !get_bit(occupied, from + up) && !get_bit(occupied, to);
+			const bool capture = get_bit(pawn_attacks[Us][from], to) && (get_bit(enemy, to) || to == pos.en_pessant_square(Us));
+			if(!push && !double_push && !capture)
+				return false;
+			break;
+		}
+		case KNIGHT:
+			if(!get_bit(knight_attacks[from], to))
+				return false;
+			break;
+		case BISHOP:
+			if(!get_bit(bishop_attacks(from, occupied), to))
+				return false;
+			break;
+		case ROOK:
+			if(!get_bit(rook_attacks(from, occupied), to))
+				return false;
+			break;
+		case QUEEN:
+			if(!get_bit(bishop_attacks(from, occupied) | rook_attacks(from, occupied), to))
+				return false;
+			break;
+		case KING:
+			if(to == from + 2 || to == from - 2) {
+				// Castling has enough special rules to simply ask the generator
+				struct move_list list;
+				generate<Us, GEN_QUIETS>(pos, list);
+				for(int i = 0; i < list.size; ++i)
+					if(list.moves[i] == m)
+						return true;
+				return false;
+			}
+			if(!get_bit(king_attacks[from], to))
+				return false;
+			break;
+	}
+
+	struct board::position after = pos;
+	make_move(after, m);
+	return !in_check<Us>(after);
+}
+
+template bool NerdChess::movegen::is_legal<WHITE>(const struct board::position&, move);
+template bool NerdChess::movegen::is_legal<BLACK>(const struct board::position&, move);
+
+bool NerdChess::movegen::is_capture(const struct board::position& pos, move m) {
+	const int to = move_to(m);
+	if(move_promotion(m) || !board::is_empty(pos, to))
+		return true;
+	// En pessant: a pawn changing its file without capturing anything on the target square
+	return (get_bit(pos.pieces[PAWN], move_from(m)) || get_bit(pos.pieces[PAWN+_BLACK], move_from(m))) && GET_FILE(to) != GET_FILE(move_from(m));
+}
+
+void NerdChess::movegen::make_move(struct board::position& pos, move m, struct board::undo* undo) {
+	board::move_piece(pos, move_from(m), move_to(m), move_promotion(m) ? move_promotion(m) : QUEEN, undo);
+}
+
+template<bool Us>
+uint64_t NerdChess::movegen::perft(const struct board::position& pos, int depth) {
+	struct move_list list;
+	generate<Us>(pos, list);
+	if(depth <= 1)
+		return depth == 1 ? list.size : 1;
+
+	uint64_t nodes = 0;
+	for(int i = 0; i < list.size; ++i) {
+		struct board::position next = pos;
+		make_move(next, list.moves[i]);
+		nodes += perft<!Us>(next, depth - 1);
+	}
+	return nodes;
+}
+
+template uint64_t NerdChess::movegen::perft<WHITE>(const struct board::position&, int);
+template uint64_t NerdChess::movegen::perft<BLACK>(const struct board::position&, int);
+
+uint64_t NerdChess::movegen::perft(const struct board::position& pos, bool side, int depth) {
+	return side ? perft<BLACK>(pos, depth) : perft<WHITE>(pos, depth);
+}
@@ -0,0 +1,64 @@
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include <iostream>
+#include "position.h"
+
+#define MAX_MOVES 256
+#define NO_MOVE 0
+
+namespace NerdChess {
+namespace movegen {
+// A move packed into 16 bits: from square (bits 0-5), to square (bits 6-11) and
+// the piece type a pawn promotes to (bits 12-14, 0 if the move is not a promotion)
+typedef uint16_t move;
+
+inline move make_move(int from, int to, int promotion = 0) { return (move)(from | (to << 6) | (promotion << 12)); }
+inline int move_from(move m) { return m & 63; }
+inline int move_to(move m) { return (m >> 6) & 63; }
+inline int move_promotion(move m) { return m >> 12; }
+
+// What generate() produces: every legal move, only captures and promotions, or only the remaining (quiet) moves
+enum gen_type {
+	GEN_ALL,
+	GEN_CAPTURES,
+	GEN_QUIETS
+};
+
+struct move_list {
+	move moves[MAX_MOVES];
+	int size;
+};
+
+// Attack tables, filled by init()
+extern bitb::bitboard knight_attacks[64];
+extern bitb::bitboard king_attacks[64];
+extern bitb::bitboard pawn_attacks[2][64]; // Squares attacked by a pawn of the given color
+extern bitb::bitboard between[64][64]; // Squares strictly between two squares on a line (0 if not on a line)
+extern bitb::bitboard line[64][64]; // Whole line through two squares (0 if not on a line)
+
+void init();
+bitb::bitboard bishop_attacks(int square, bitb::bitboard occupied);
+bitb::bitboard rook_attacks(int square, bitb::bitboard occupied);
+bitb::bitboard attackers_to(const struct board::position& pos, int square, bitb::bitboard occupied);
+
+template<bool Us> bool in_check(const struct board::position& pos);
+bool in_check(const struct board::position& pos, bool side);
+
+// Generates the legal moves of the side to move. Checkers and pinned pieces are computed once,
+// so moves that would leave the king in check are never generated. An empty list means
+// checkmate if in_check(), stalemate otherwise.
+template<bool Us, gen_type Type = GEN_ALL> void generate(const struct board::position& pos, struct move_list& list);
+void generate(const struct board::position& pos, bool side, struct move_list& list);
+
+template<bool Us> bool is_legal(const struct board::position& pos, move m);
+bool is_capture(const struct board::position& pos, move m); // Captures (including en pessant) and promotions
+void make_move(struct board::position& pos, move m, struct board::undo* undo = nullptr); // Take back with board::undo_move
+
+// Counts the leaf nodes of the legal move tree (to compare with published perft numbers)
+template<bool Us> uint64_t perft(const struct board::position& pos, int depth);
+uint64_t perft(const struct board::position& pos, bool side, int depth);
+} // namespace movegen
+} // namespace NerdChess
+
+#endif
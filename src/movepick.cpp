@@ -0,0 +1,222 @@
+#include <iostream>
+#include "movepick.h"
+#include "eval.h"
+#include "stats.h"
+
+#define SEE_KING_VALUE 20000
+
+void NerdChess::engine::init_picker(struct move_picker& picker, const struct board::position& pos, movegen::move hash_move, const movegen::move killers[2]) {
+    picker.pos = &pos;
+    picker.stage = STAGE_HASH;
+    picker.hash_move = hash_move;
+    picker.killers[0] = killers ? killers[0] : NO_MOVE;
+    picker.killers[1] = killers ? killers[1] : NO_MOVE;
+    picker.index = 0;
+    picker.bad_count = 0;
+}
+
+void NerdChess::engine::init_quiescence_picker(struct move_picker& picker, const struct board::position& pos) {
+    init_picker(picker, pos, NO_MOVE, nullptr);
+    picker.stage = STAGE_QS_GEN_CAPTURES;
+}
+
+static inline int piece_value(int type) {
+    return type == KING ? SEE_KING_VALUE : NerdChess::eval::active_params[NerdChess::eval::PARAM_PAWN_VALUE + type];
+}
+
+// Piece type on a square regardless of color, without copying the position
+static int piece_on(const struct NerdChess::board::position& pos, int square) {
+    for(int i = 0; i < 12; ++i)
+        if(NerdChess::bitb::get_bit(pos.pieces[i], square))
+            return i % _BLACK;
+    return EMPTY;
+}
+
+// Most valuable victim, least valuable attacker. Promotions are scored by the piece they promote to.
+static void score_captures(struct NerdChess::engine::move_picker& picker) {
+    for(int i = 0; i < picker.list.size; ++i) {
+        const NerdChess::movegen::move m = picker.list.moves[i];
+        int victim = piece_on(*picker.pos, NerdChess::movegen::move_to(m));
+        if(victim == EMPTY)
+            victim = NerdChess::movegen::move_promotion(m) ? PAWN - 1 : PAWN; // A promotion without capture or en pessant
+        const int attacker = piece_on(*picker.pos, NerdChess::movegen::move_from(m));
+        picker.scores[i] = (victim + 1) * 8 - attacker + NerdChess::movegen::move_promotion(m) * 8;
+    }
+}
+
+int NerdChess::engine::see(const struct board::position& pos, movegen::move m) {
+    const int from = movegen::move_from(m), to = movegen::move_to(m);
+    const bitb::bitboard diagonal = pos.pieces[BISHOP] | pos.pieces[BISHOP+_BLACK] | pos.pieces[QUEEN] | pos.pieces[QUEEN+_BLACK];
+    const bitb::bitboard straight = pos.pieces[ROOK] | pos.pieces[ROOK+_BLACK] | pos.pieces[QUEEN] | pos.pieces[QUEEN+_BLACK];
+    bitb::bitboard occupied = board::map_pieces(pos);
+    int attacker = piece_on(pos, from);
+    bool side = bitb::get_bit(board::map_pieces(pos, BLACK), from);
+    int gain[32];
+
+    int victim = piece_on(pos, to);
+    if(victim == EMPTY && attacker == PAWN && GET_FILE(to) != GET_FILE(from)) {
+        // En pessant, the pawn is taken behind the target square
+        victim = PAWN;
+        occupied ^= 1ULL << (side ? to - 8 : to + 8);
+    }
+    gain[0] = victim == EMPTY ? 0 : piece_value(victim);
+    if(movegen::move_promotion(m)) {
+        gain[0] += piece_value(movegen::move_promotion(m)) - piece_value(PAWN);
+        attacker = movegen::move_promotion(m);
+    }
+
+    occupied ^= 1ULL << from;
+    bitb::bitboard attackers = movegen::attackers_to(pos, to, occupied) & occupied;
+    int d = 0;
+    while(d < 31) {
+        side = !side;
+        const bitb::bitboard own = attackers & board::map_pieces(pos, side);
+        if(!own)
+            break;
+        // The piece standing on the square is taken next, by the cheapest attacker
+        int type = PAWN;
+        while(!(own & pos.pieces[type + (side ? _BLACK : 0)]))
+            type++;
+        // A king can't take if the square is still defended
+        if(type == KING && (attackers & ~own))
+            break;
+        d++;
+        gain[d] = piece_value(attacker) - gain[d - 1];
+        if(std::max(-gain[d - 1], gain[d]) < 0)
+            break; // Neither side would continue from here
+
+        occupied ^= 1ULL << bitb::lsb(own & pos.pieces[type + (side ? _BLACK : 0)]);
+        if(type == PAWN || type == BISHOP || type == QUEEN)
+            attackers |= movegen::bishop_attacks(to, occupied) & diagonal;
+        if(type == ROOK || type == QUEEN)
+            attackers |= movegen::rook_attacks(to, occupied) & straight;
+        attackers &= occupied;
+        attacker = type;
+    }
+    // Either side can stop capturing whenever that is better for it
+    while(d > 0) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+        d--;
+    }
+    return gain[0];
+}
+
+// Only worth an exchange evaluation if the attacker is worth more than what it takes
+static inline bool loses_material(const struct NerdChess::board::position& pos, NerdChess::movegen::move m) {
+    if(NerdChess::movegen::move_promotion(m))
+        return false;
+    const int victim = piece_on(pos, NerdChess::movegen::move_to(m));
+    const int attacker = piece_on(pos, NerdChess::movegen::move_from(m));
+    if(victim != EMPTY && piece_value(victim) >= piece_value(attacker))
+        return false;
+    return NerdChess::engine::see(pos, m) < 0;
+}
+
+// Selection sort step: swaps the best remaining move to the current index
+static NerdChess::movegen::move pick_best(struct NerdChess::engine::move_picker& picker) {
+    int best = picker.index;
+    for(int i = picker.index + 1; i < picker.list.size; ++i)
+        if(picker.scores[i] > picker.scores[best])
+            best = i;
+    std::swap(picker.list.moves[best], picker.list.moves[picker.index]);
+    std::swap(picker.scores[best], picker.scores[picker.index]);
+    return picker.list.moves[picker.index++];
+}
+
+template<bool Us>
+NerdChess::movegen::move NerdChess::engine::next_move(struct move_picker& picker) {
+    switch(picker.stage) {
+        case STAGE_HASH:
+            picker.stage++;
+            if(picker.hash_move != NO_MOVE && movegen::is_legal<Us>(*picker.pos, picker.hash_move))
+                return picker.hash_move;
+            // Fall through
+
+        case STAGE_GEN_CAPTURES: {
+            STATS_INC(movegen_calls);
+            STATS_TIMER_START(movegen_start);
+            movegen::generate<Us, movegen::GEN_CAPTURES>(*picker.pos, picker.list);
+            score_captures(picker);
+            STATS_TIMER_STOP(movegen_start, movegen_ticks);
+            picker.index = 0;
+            picker.stage++;
+        }
+            // Fall through
+
+        case STAGE_CAPTURES:
+            while(picker.index < picker.list.size) {
+                const movegen::move m = pick_best(picker);
+                if(m == picker.hash_move)
+                    continue;
+                if(loses_material(*picker.pos, m))
+                    picker.bad_captures[picker.bad_count++] = m; // Tried after the quiet moves
+                else
+                    return m;
+            }
+            picker.stage++;
+            // Fall through
+
+        case STAGE_KILLER_1:
+            picker.stage++;
+            if(picker.killers[0] != NO_MOVE && picker.killers[0] != picker.hash_move && movegen::is_legal<Us>(*picker.pos, picker.killers[0]) && !movegen::is_capture(*picker.pos, picker.killers[0]))
+                return picker.killers[0];
+            // Fall through
+
+        case STAGE_KILLER_2:
+            picker.stage++;
+            if(picker.killers[1] != NO_MOVE && picker.killers[1] != picker.hash_move && picker.killers[1] != picker.killers[0] && movegen::is_legal<Us>(*picker.pos, picker.killers[1]) && !movegen::is_capture(*picker.pos, picker.killers[1]))
+                return picker.killers[1];
+            // Fall through
+
+        case STAGE_GEN_QUIETS: {
+            STATS_INC(movegen_calls);
+            STATS_TIMER_START(movegen_start);
+            movegen::generate<Us, movegen::GEN_QUIETS>(*picker.pos, picker.list);
+            STATS_TIMER_STOP(movegen_start, movegen_ticks);
+            picker.index = 0;
+            picker.stage++;
+        }
+            // Fall through
+
+        case STAGE_QUIETS:
+            while(picker.index < picker.list.size) {
+                const movegen::move m = picker.list.moves[picker.index++];
+                if(m != picker.hash_move && m != picker.killers[0] && m != picker.killers[1])
+                    return m;
+            }
+            picker.index = 0;
+            picker.stage++;
+            // Fall through
+
+        case STAGE_BAD_CAPTURES:
+            if(picker.index < picker.bad_count)
+                return picker.bad_captures[picker.index++];
+            picker.stage++;
+            // Fall through
+
+        case STAGE_DONE:
+            break;
+
+        case STAGE_QS_GEN_CAPTURES:
+            STATS_INC(movegen_calls);
+            movegen::generate<Us, movegen::GEN_CAPTURES>(*picker.pos, picker.list);
+            score_captures(picker);
+            picker.index = 0;
+            picker.stage++;
+            // Fall through
+
+        case STAGE_QS_CAPTURES:
+            while(picker.index < picker.list.size) {
+                const movegen::move m = pick_best(picker);
+                if(!loses_material(*picker.pos, m))
+                    return m;
+                STATS_INC(see_pruned);
+            }
+            picker.stage = STAGE_DONE;
+            break;
+    }
+    return NO_MOVE;
+}
+
+template NerdChess::movegen::move NerdChess::engine::next_move<WHITE>(struct move_picker&);
+template NerdChess::movegen::move NerdChess::engine::next_move<BLACK>(struct move_picker&);
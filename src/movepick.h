@@ -0,0 +1,54 @@
+#ifndef MOVEPICK_H
+#define MOVEPICK_H
+
+#include <iostream>
+#include "movegen.h"
+
+#define MAX_PLY 128
+
+namespace NerdChess {
+namespace engine {
+// Stages of the move picker, in the order in which moves are returned
+enum pick_stage {
+    STAGE_HASH,
+    STAGE_GEN_CAPTURES,
+    STAGE_CAPTURES,
+    STAGE_KILLER_1,
+    STAGE_KILLER_2,
+    STAGE_GEN_QUIETS,
+    STAGE_QUIETS,
+    STAGE_BAD_CAPTURES,
+    STAGE_DONE,
+    // Quiescence search: only the captures which don't lose material
+    STAGE_QS_GEN_CAPTURES,
+    STAGE_QS_CAPTURES
+};
+
+// Hands out the moves of a position one at a time: the hash move first, then captures (best victim
+// and cheapest attacker first), then the killer moves, the quiet moves and last the captures which
+// lose material (see below). Each group is only generated once the previous one is used up, so a
+// cutoff early on saves the rest of the work.
+struct move_picker {
+    const struct board::position* pos;
+    int stage;
+    movegen::move hash_move;
+    movegen::move killers[2];
+    struct movegen::move_list list;
+    int scores[MAX_MOVES];
+    int index;
+    movegen::move bad_captures[MAX_MOVES];
+    int bad_count;
+};
+
+void init_picker(struct move_picker& picker, const struct board::position& pos, movegen::move hash_move, const movegen::move killers[2]);
+void init_quiescence_picker(struct move_picker& picker, const struct board::position& pos);
+template<bool Us> movegen::move next_move(struct move_picker& picker); // Returns NO_MOVE when there are no moves left
+
+// Static exchange evaluation: the material the side making the capture m wins (negative if it loses)
+// when both sides keep recapturing on the target square with their cheapest piece, each side stopping
+// once going on would lose. Sliders behind the capturing pieces (x-rays) join in. Pins are ignored.
+int see(const struct board::position& pos, movegen::move m);
+} // namespace engine
+} // namespace NerdChess
+
+#endif
@@ -0,0 +1,444 @@
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include "pgn.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define PGN_BATCH_GAMES 64 // Games handed to a worker at once
+#define PGN_CHUNK_SIZE (16 * 1024 * 1024) // Read size when the file can't be mapped
+
+static const char* piece_letters = "PNBRQK";
+
+static inline int square_of(char file, char rank) {
+    return (8 - (rank - '0')) * 8 + (file - 'a');
+}
+
+static inline bool is_file(char c) { return c >= 'a' && c <= 'h'; }
+static inline bool is_rank(char c) { return c >= '1' && c <= '8'; }
+
+NerdChess::movegen::move NerdChess::pgn::parse_san(const struct board::position& pos, bool side, const std::string& token) {
+    std::string san = token;
+    while(!san.empty() && strchr("+#!?", san.back()))
+        san.pop_back();
+    if(san.size() < 2)
+        return NO_MOVE;
+
+    struct movegen::move_list list;
+    movegen::generate(pos, side, list);
+    const int king = bitb::lsb(pos.pieces[KING + (side ? _BLACK : 0)]);
+
+    // Castling (also written with zeros)
+    if(san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        const int to = san.size() == 3 ? king + 2 : king - 2;
+        for(int i = 0; i < list.size; ++i)
+            if(movegen::move_from(list.moves[i]) == king && movegen::move_to(list.moves[i]) == to)
+                return list.moves[i];
+        return NO_MOVE;
+    }
+
+    int piece = PAWN;
+    size_t begin = 0;
+    if(strchr("NBRQK", san[0])) {
+        piece = strchr(piece_letters, san[0]) - piece_letters;
+        begin = 1;
+    }
+
+    // Promotion, "e8=Q" or "e8Q"
+    int promotion = 0;
+    size_t end = san.size();
+    if(piece == PAWN && strchr("NBRQ", san[end - 1])) {
+        promotion = strchr(piece_letters, san[end - 1]) - piece_letters;
+        end--;
+        if(end > 0 && san[end - 1] == '=')
+            end--;
+    }
+    if(end < begin + 2 || !is_file(san[end - 2]) || !is_rank(san[end - 1]))
+        return NO_MOVE;
+    const int to = square_of(san[end - 2], san[end - 1]);
+
+    // Whatever is left between the piece and the destination narrows down the origin
+    int from_file = -1, from_rank = -1;
+    for(size_t i = begin; i < end - 2; ++i) {
+        if(is_file(san[i]))
+            from_file = san[i] - 'a';
+        else if(is_rank(san[i]))
+            from_rank = san[i] - '0';
+        else if(san[i] != 'x' && san[i] != '-' && san[i] != ':')
+            return NO_MOVE;
+    }
+
+    movegen::move found = NO_MOVE;
+    for(int i = 0; i < list.size; ++i) {
+        const movegen::move m = list.moves[i];
+        const int from = movegen::move_from(m);
+        if(movegen::move_to(m) != to || movegen::move_promotion(m) != promotion)
+            continue;
+        if(!bitb::get_bit(pos.pieces[piece + (side ? _BLACK : 0)], from))
+            continue;
+        if((from_file >= 0 && from % 8 != from_file) || (from_rank >= 0 && 8 - from / 8 != from_rank))
+            continue;
+        if(found != NO_MOVE)
+            return NO_MOVE; // Ambiguous
+        found = m;
+    }
+    return found;
+}
+
+std::string NerdChess::pgn::to_san(const struct board::position& pos, bool side, movegen::move m) {
+    const int from = movegen::move_from(m);
+    const int to = movegen::move_to(m);
+    const int piece = board::get_piece_type(pos, from);
+    const bool capture = movegen::is_capture(pos, m) && !(piece == PAWN && from % 8 == to % 8);
+    std::string san;
+
+    if(piece == KING && (to - from == 2 || from - to == 2)) {
+        san = to > from ? "O-O" : "O-O-O";
+    } else {
+        if(piece == PAWN) {
+            if(capture)
+                san += (char)('a' + from % 8);
+        } else {
+            san += piece_letters[piece];
+            // Name the file, the rank or both if another piece of the same kind can go there too
+            struct movegen::move_list list;
+            movegen::generate(pos, side, list);
+            bool others = false, same_file = false, same_rank = false;
+            for(int i = 0; i < list.size; ++i) {
+                const int other = movegen::move_from(list.moves[i]);
+                if(other == from || movegen::move_to(list.moves[i]) != to || board::get_piece_type(pos, other) != piece)
+                    continue;
+                others = true;
+                same_file |= other % 8 == from % 8;
+                same_rank |= other / 8 == from / 8;
+            }
+            if(others && (!same_file || same_rank))
+                san += (char)('a' + from % 8);
+            if(others && same_file)
+                san += (char)('8' - from / 8);
+        }
+        if(capture)
+            san += 'x';
+        san += (char)('a' + to % 8);
+        san += (char)('8' - to / 8);
+        if(movegen::move_promotion(m)) {
+            san += '=';
+            san += piece_letters[movegen::move_promotion(m)];
+        }
+    }
+
+    struct board::position next = pos;
+    movegen::make_move(next, m);
+    if(movegen::in_check(next, !side)) {
+        struct movegen::move_list replies;
+        movegen::generate(next, !side, replies);
+        san += replies.size ? '+' : '#';
+    }
+    return san;
+}
+
+bool NerdChess::pgn::parse_game(const char* text, size_t size, struct game& g) {
+    g.tags.clear();
+    g.moves.clear();
+    g.keys.clear();
+    g.error.clear();
+    g.result = RESULT_UNKNOWN;
+    bool started = false; // Set up the start position once the tags are done
+    struct board::position pos;
+    bool side = WHITE;
+
+    const char* p = text;
+    const char* end = text + size;
+    while(p < end) {
+        const char c = *p;
+        if(c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '.') {
+            p++;
+        } else if(c == '[') {
+            // [Name "Value"]
+            const char* name = ++p;
+            while(p < end && *p != ' ' && *p != ']')
+                p++;
+            std::string tag_name(name, p);
+            while(p < end && *p != '"' && *p != ']')
+                p++;
+            std::string value;
+            if(p < end && *p == '"') {
+                for(p++; p < end && *p != '"'; ++p) {
+                    if(*p == '\\' && p + 1 < end)
+                        p++;
+                    value += *p;
+                }
+            }
+            while(p < end && *p != ']')
+                p++;
+            p++;
+            g.tags.emplace_back(std::move(tag_name), std::move(value));
+        } else if(c == '{') {
+            while(p < end && *p != '}')
+                p++;
+            p++;
+        } else if(c == ';' || (c == '%' && (p == text || p[-1] == '\n'))) {
+            while(p < end && *p != '\n')
+                p++;
+        } else if(c == '(') {
+            // Variations can be nested and contain comments
+            int depth = 0;
+            for(; p < end; ++p) {
+                if(*p == '{') {
+                    while(p < end && *p != '}')
+                        p++;
+                } else if(*p == '(') {
+                    depth++;
+                } else if(*p == ')' && --depth == 0) {
+                    p++;
+                    break;
+                }
+            }
+        } else if(c == '$') {
+            for(p++; p < end && *p >= '0' && *p <= '9'; ++p);
+        } else {
+            const char* token = p;
+            while(p < end && *p && !strchr(" \t\r\n{}();[", *p))
+                p++;
+            if(p == token) {
+                p++; // Stray ')' or the like
+                continue;
+            }
+            std::string san(token, p);
+            if(san == "1-0" || san == "0-1" || san == "1/2-1/2" || san == "*") {
+                g.result = san == "1-0" ? RESULT_WHITE_WIN : san == "0-1" ? RESULT_BLACK_WIN : san == "*" ? RESULT_UNKNOWN : RESULT_DRAW;
+                break;
+            }
+            // Move numbers, "12." or "12...Nf6"
+            size_t digits = 0;
+            while(digits < san.size() && san[digits] >= '0' && san[digits] <= '9')
+                digits++;
+            if(digits > 0 && (digits == san.size() || san[digits] == '.')) {
+                p = token + digits;
+                continue;
+            }
+            if(!g.error.empty())
+                continue; // Skip the rest of a broken game, but still look for its result
+
+            if(!started) {
+                started = true;
+                side = WHITE;
+                bool from_fen = false;
+                for(const auto& tag : g.tags)
+                    if(tag.first == "FEN")
+                        from_fen = board::load_fen(pos, tag.second, side);
+                if(!from_fen)
+                    board::setup_position(pos);
+                g.start = pos;
+                g.start_side = side;
+            }
+            const movegen::move m = parse_san(pos, side, san);
+            if(m == NO_MOVE) {
+                g.error = "Illegal or unreadable move " + san;
+                continue;
+            }
+            g.keys.push_back(pos.key);
+            g.moves.push_back(m);
+            movegen::make_move(pos, m);
+            side = !side;
+        }
+    }
+    if(!started) {
+        board::setup_position(g.start);
+        g.start_side = WHITE;
+        pos = g.start;
+    }
+    g.keys.push_back(pos.key);
+    return g.error.empty();
+}
+
+// Games of one batch, pointing into the mapped file or into buffer
+struct batch {
+    std::shared_ptr<std::string> buffer;
+    std::vector<std::pair<const char*, size_t>> games;
+};
+
+// Hands batches from the reading thread to the workers, holding at most limit of them
+struct batch_queue {
+    std::mutex mutex;
+    std::condition_variable not_empty, not_full;
+    std::deque<struct batch> batches;
+    size_t limit;
+    bool done;
+};
+
+static void push(struct batch_queue& queue, struct batch&& b) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.not_full.wait(lock, [&queue]() { return queue.batches.size() < queue.limit; });
+    queue.batches.push_back(std::move(b));
+    queue.not_empty.notify_one();
+}
+
+static bool pop(struct batch_queue& queue, struct batch& b) {
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    queue.not_empty.wait(lock, [&queue]() { return !queue.batches.empty() || queue.done; });
+    if(queue.batches.empty())
+        return false;
+    b = std::move(queue.batches.front());
+    queue.batches.pop_front();
+    queue.not_full.notify_one();
+    return true;
+}
+
+// Splits text into games: a game ends where a tag line follows movetext. Returns how much of text was used,
+// the rest is an unfinished game unless last is set.
+static size_t split_games(const char* text, size_t size, bool last, struct batch_queue& queue, const std::shared_ptr<std::string>& buffer) {
+    struct batch b;
+    b.buffer = buffer;
+    const char* game = nullptr;
+    bool movetext = false;
+    const char* p = text;
+    const char* end = text + size;
+    while(p < end) {
+        const char* line = p;
+        const char* newline = (const char*)memchr(p, '\n', end - p);
+        if(!newline && !last)
+            break;
+        p = newline ? newline + 1 : end;
+
+        const char* first = line;
+        while(first < p && (*first == ' ' || *first == '\t' || *first == '\r'))
+            first++;
+        if(first == p || *first == '\n')
+            continue;
+        if(*first == '[') {
+            if(movetext) {
+                b.games.emplace_back(game, line - game);
+                movetext = false;
+                game = nullptr;
+                if(b.games.size() == PGN_BATCH_GAMES) {
+                    push(queue, std::move(b));
+                    b = batch();
+                    b.buffer = buffer;
+                }
+            }
+        } else {
+            movetext = true;
+        }
+        if(!game)
+            game = line;
+    }
+
+    size_t used = game ? game - text : p - text;
+    if(game && last) {
+        b.games.emplace_back(game, end - game);
+        used = size;
+    }
+    if(!b.games.empty())
+        push(queue, std::move(b));
+    return used;
+}
+
+static void worker(struct batch_queue& queue, struct NerdChess::pgn::read_stats& totals, std::mutex& totals_mutex,
+                   const std::function<void(const struct NerdChess::pgn::game&)>& on_game) {
+    struct NerdChess::pgn::read_stats stats = {};
+    struct NerdChess::pgn::game g;
+    struct batch b;
+    while(pop(queue, b)) {
+        for(const auto& text : b.games) {
+            const bool ok = NerdChess::pgn::parse_game(text.first, text.second, g);
+            stats.games++;
+            stats.bad_games += !ok;
+            stats.moves += g.moves.size();
+            if(g.result != RESULT_UNKNOWN)
+                stats.results[g.result + 1]++;
+            if(on_game)
+                on_game(g);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    totals.games += stats.games;
+    totals.bad_games += stats.bad_games;
+    totals.moves += stats.moves;
+    for(int i = 0; i < 3; ++i)
+        totals.results[i] += stats.results[i];
+}
+
+struct NerdChess::pgn::read_stats NerdChess::pgn::read_file(const std::string& path, int threads, const std::function<void(const struct game&)>& on_game) {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    struct read_stats totals = {};
+    std::mutex totals_mutex;
+    struct batch_queue queue;
+    threads = std::max(1, threads);
+    queue.limit = threads * 4;
+    queue.done = false;
+
+    std::vector<std::thread> pool;
+    for(int i = 0; i < threads; ++i)
+        pool.emplace_back(worker, std::ref(queue), std::ref(totals), std::ref(totals_mutex), std::cref(on_game));
+
+    bool mapped = false;
+#if !defined(_WIN32)
+    // Pages are only read in when a worker gets to them, and the kernel reads ahead for us
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    totals.opened = fd >= 0;
+    if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED) {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            split_games((const char*)data, st.st_size, true, queue, nullptr);
+            totals.bytes = st.st_size;
+            mapped = true;
+
+            // The workers still point into the mapping
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.done = true;
+            }
+            queue.not_empty.notify_all();
+            for(std::thread& thread : pool)
+                thread.join();
+            munmap(data, st.st_size);
+        }
+    }
+    if(fd >= 0)
+        close(fd);
+#endif
+
+    if(!mapped) {
+        // Read in chunks, carrying an unfinished game over to the next one
+        std::ifstream file(path, std::ios::binary);
+        totals.opened = file.is_open();
+        std::string carry;
+        while(file) {
+            std::shared_ptr<std::string> buffer = std::make_shared<std::string>(std::move(carry));
+            const size_t old_size = buffer->size();
+            buffer->resize(old_size + PGN_CHUNK_SIZE);
+            file.read(&(*buffer)[old_size], PGN_CHUNK_SIZE);
+            buffer->resize(old_size + file.gcount());
+            totals.bytes += file.gcount();
+            const bool last = !file;
+            const size_t used = split_games(buffer->data(), buffer->size(), last, queue, buffer);
+            carry.assign(buffer->data() + used, buffer->size() - used);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.done = true;
+        }
+        queue.not_empty.notify_all();
+        for(std::thread& thread : pool)
+            thread.join();
+    }
+
+    totals.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return totals;
+}
@@ -0,0 +1,50 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include "movegen.h"
+
+// Game results
+#define RESULT_WHITE_WIN 1
+#define RESULT_DRAW 0
+#define RESULT_BLACK_WIN -1
+#define RESULT_UNKNOWN 2
+
+namespace NerdChess {
+namespace pgn {
+struct game {
+    std::vector<std::pair<std::string, std::string>> tags;
+    int result;
+    struct board::position start; // Start position (from the FEN tag if there is one)
+    bool start_side; // Side to move in the start position
+    std::vector<movegen::move> moves;
+    std::vector<uint64_t> keys; // Hash of the position before every move and of the final position
+    std::string error; // Empty if every move could be replayed
+};
+
+struct read_stats {
+    uint64_t games;
+    uint64_t bad_games; // Games with an illegal or unreadable move (the moves before it are still reported)
+    uint64_t moves;
+    uint64_t bytes;
+    uint64_t results[3]; // Black wins, draws, white wins
+    double seconds;
+    bool opened; // False if the file couldn't be opened, everything else is 0 then
+};
+
+// Parses one game (tags and movetext) and replays its moves. Returns false if a move could not be resolved.
+bool parse_game(const char* text, size_t size, struct game& g);
+// Resolves a SAN move ("Nbd7", "exd8=Q+", "O-O") among the legal moves of the position. Returns NO_MOVE if there is none.
+movegen::move parse_san(const struct board::position& pos, bool side, const std::string& san);
+std::string to_san(const struct board::position& pos, bool side, movegen::move m);
+
+// Streams a PGN file (memory mapped where possible, so it is never read in one piece) and parses the games on
+// threads worker threads. on_game is called from the workers, in no particular order, so it has to be thread-safe.
+struct read_stats read_file(const std::string& path, int threads, const std::function<void(const struct game&)>& on_game);
+} // namespace pgn
+} // namespace NerdChess
+
+#endif
@@ -1,17 +1,63 @@
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <algorithm>
 #include "position.h"
+#include "setwise.h"
 
 using namespace NerdChess::bitb;
 
-bool NerdChess::board::is_empty(struct NerdChess::board::position board, uint8_t square_location) {
+// Random numbers for Zobrist hashing, generated at compile time so the keys are the same on every run
+struct zobrist_keys {
+	uint64_t pieces[12][64];
+	uint64_t castling[16]; // Indexed by position::castling
+	uint64_t en_pessant[NO_SQUARE + 1]; // 0 for NO_SQUARE
+	uint64_t side; // Black to move
+};
+
+static constexpr struct zobrist_keys make_zobrist_keys() {
+	struct zobrist_keys keys = {};
+	uint64_t seed = 1070372ULL;
+	auto next = [&seed]() {
+		// xorshift64*
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		return seed * 2685821657736338717ULL;
+	};
+	for(int i = 0; i < 12; ++i)
+		for(int j = 0; j < 64; ++j)
+			keys.pieces[i][j] = next();
+	for(int i = 0; i < 16; ++i)
+		keys.castling[i] = next();
+	for(int i = 0; i < 64; ++i)
+		keys.en_pessant[i] = next();
+	keys.side = next();
+	return keys;
+}
+
+static constexpr struct zobrist_keys zobrist = make_zobrist_keys();
+
+// Castling rights lost when a piece moves from or to the square (king or rook squares)
+static constexpr uint8_t castling_lost[64] = {
+	8, 0, 0, 0, 12, 0, 0, 4,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	2, 0, 0, 0, 3, 0, 0, 1,
+};
+
+bool NerdChess::board::is_empty(const struct NerdChess::board::position& board, uint8_t square_location) {
 	for(int i = 0; i < 12; ++i)
 		if(NerdChess::bitb::get_bit(board.pieces[i], square_location))
 			return false;
 	return true;
 }
 
-bool NerdChess::board::piece_color_at(struct position board, uint8_t square_location, uint8_t piece_color) {
+bool NerdChess::board::piece_color_at(const struct position& board, uint8_t square_location, uint8_t piece_color) {
 	if(!piece_color) {
 		for(int i = 0; i < 6; ++i)
 			if(NerdChess::bitb::get_bit(board.pieces[i], square_location))
@@ -24,7 +70,7 @@ bool NerdChess::board::piece_color_at(struct position board, uint8_t square_loca
 	return false;
 }
 
-int NerdChess::board::get_piece_type(struct position board, uint8_t square_location) {
+int NerdChess::board::get_piece_type(const struct position& board, uint8_t square_location) {
 	for(int i = 0; i < 6; ++i)
 		if(NerdChess::bitb::get_bit(board.pieces[i], square_location))
 			return i;
@@ -34,7 +80,7 @@ int NerdChess::board::get_piece_type(struct position board, uint8_t square_locat
 	return EMPTY;
 }
 
-int NerdChess::board::get_full_piece_type(struct position board, uint8_t square_location) {
+int NerdChess::board::get_full_piece_type(const struct position& board, uint8_t square_location) {
 	for(int i = 0; i < 12; ++i)
 		if(NerdChess::bitb::get_bit(board.pieces[i], square_location))
 			return i;
@@ -46,73 +92,152 @@ void NerdChess::board::remove_piece(struct position& board, int square_location)
 		clear_bit(board.pieces[i], square_location);
 }
 
-void NerdChess::board::move_piece(struct position& board, int from, int to) {
-	int piece = get_full_piece_type(board, from);
-	remove_piece(board, to);
+void NerdChess::board::move_piece(struct position& board, int from, int to, int promotion, struct undo* undo) {
+	const int piece = get_full_piece_type(board, from);
+	if(piece == EMPTY)
+		return;
+	const bool color = piece >= _BLACK;
+	const int en_pessant_square = board.en_pessant_square(color); // Only valid for this one move
+	int captured = get_full_piece_type(board, to);
+	int capture_square = to;
+	if(undo) {
+		undo->key = board.key;
+		undo->piece = piece;
+		undo->from = from;
+		undo->to = to;
+		undo->promotion = 0;
+		undo->castling = board.castling;
+		undo->en_pessant = board.en_pessant;
+		undo->side = board.side;
+		undo->halfmove_clock = board.halfmove_clock;
+	}
+
+	// Castling rights and the en pessant square are hashed out here and back in at the end
+	uint64_t key = board.key ^ zobrist.side ^ zobrist.castling[board.castling] ^ zobrist.en_pessant[board.en_pessant];
+	board.en_pessant = NO_SQUARE;
+
+	key ^= zobrist.pieces[piece][from] ^ zobrist.pieces[piece][to];
+	if(captured != EMPTY) {
+		key ^= zobrist.pieces[captured][to];
+		bitb::clear_bit(board.pieces[captured], to);
+	}
 	NerdChess::bitb::move_bit(board.pieces[piece], from, to);
 
 	// Special pawn moves
 	if(piece == PAWN) {
 		// White pawn
 
-		if((from - to) == 16)
-			board.en_pessant_squares[BLACK] = to + 8;
+		// The en pessant square is only set if a black pawn is next to the pawn and can actually take it
+		if((from - to) == 16 && ((to % 8 != 0 && get_bit(board.pieces[PAWN+_BLACK], to - 1)) || (to % 8 != 7 && get_bit(board.pieces[PAWN+_BLACK], to + 1))))
+			board.en_pessant = to + 8;
 
 		// En croissant capture
-		if(!piece_color_at(board, to, BLACK))
-			bitb::clear_bit(board.pieces[6], to + 8);
+		if(to == en_pessant_square) {
+			captured = PAWN+_BLACK;
+			capture_square = to + 8;
+			bitb::clear_bit(board.pieces[PAWN+_BLACK], to + 8);
+			key ^= zobrist.pieces[PAWN+_BLACK][to + 8];
+		}
 
-		// Promote to queen
+		// Promotion
 		if(to < 8) {
-			remove_piece(board, to);
-			NerdChess::bitb::set_bit(board.pieces[QUEEN], to);
+			bitb::clear_bit(board.pieces[PAWN], to);
+			NerdChess::bitb::set_bit(board.pieces[promotion], to);
+			key ^= zobrist.pieces[PAWN][to] ^ zobrist.pieces[promotion][to];
+			if(undo)
+				undo->promotion = promotion;
 		}
-	} else if(piece == PAWN+6) {
+	} else if(piece == PAWN+_BLACK) {
 		// Black pawn
 
-		if((to - from) == 16)
-			board.en_pessant_squares[WHITE] = to - 8;
+		if((to - from) == 16 && ((to % 8 != 0 && get_bit(board.pieces[PAWN], to - 1)) || (to % 8 != 7 && get_bit(board.pieces[PAWN], to + 1))))
+			board.en_pessant = to - 8;
 
 		// En pessant capture
-		if(!piece_color_at(board, to, WHITE))
+		if(to == en_pessant_square) {
+			captured = PAWN;
+			capture_square = to - 8;
 			NerdChess::bitb::clear_bit(board.pieces[PAWN], to - 8);
+			key ^= zobrist.pieces[PAWN][to - 8];
+		}
 
-		// Promote to queen
+		// Promotion
 		if(to > 55) {
-			remove_piece(board, to);
-			NerdChess::bitb::set_bit(board.pieces[QUEEN+6], to);
+			bitb::clear_bit(board.pieces[PAWN+_BLACK], to);
+			NerdChess::bitb::set_bit(board.pieces[promotion+_BLACK], to);
+			key ^= zobrist.pieces[PAWN+_BLACK][to] ^ zobrist.pieces[promotion+_BLACK][to];
+			if(undo)
+				undo->promotion = promotion+_BLACK;
 		}
 	}
 
 	// Castling
 	if(piece == KING || piece == KING+_BLACK) {
+		const int rook = piece == KING ? ROOK : ROOK+_BLACK;
+
 		// King-side castle
 		if(to-from==2) {
-			NerdChess::bitb::clear_bit(board.pieces[ROOK], 63);
-			NerdChess::bitb::set_bit(board.pieces[ROOK], to-1);
+			NerdChess::bitb::move_bit(board.pieces[rook], from+3, to-1);
+			key ^= zobrist.pieces[rook][from+3] ^ zobrist.pieces[rook][to-1];
 		}
 
 		// Queen-side castle
 		if(from-to==2) {
-			NerdChess::bitb::clear_bit(board.pieces[ROOK], 56);
-			NerdChess::bitb::set_bit(board.pieces[ROOK], to+1);
+			NerdChess::bitb::move_bit(board.pieces[rook], from-4, to+1);
+			key ^= zobrist.pieces[rook][from-4] ^ zobrist.pieces[rook][to+1];
 		}
+	}
+
+	// Moving the king or a rook from its corner (or capturing it there) takes away castling
+	board.castling &= ~(castling_lost[from] | castling_lost[to]);
+
+	if(piece == PAWN || piece == PAWN+_BLACK || captured != EMPTY)
+		board.halfmove_clock = 0;
+	else if(board.halfmove_clock < UINT8_MAX)
+		board.halfmove_clock++;
+	board.side = !color;
+	board.key = key ^ zobrist.castling[board.castling] ^ zobrist.en_pessant[board.en_pessant];
 
-		board.castling_rights[!(piece-6 < 0)][0] = false;
-		board.castling_rights[!(piece-6 < 0)][1] = false;
+	if(undo) {
+		undo->captured = captured == EMPTY ? -1 : captured;
+		undo->capture_square = capture_square;
 	}
+}
 
-	if(piece == ROOK) {
-		if(from == 63)
-			board.castling_rights[WHITE][0] = false;
-		if(from == 56)
-			board.castling_rights[WHITE][1] = false;
-	} else if(piece == ROOK+_BLACK) {
-		if(from == 7)
-			board.castling_rights[WHITE][0] = false;
-		if(from == 0)
-			board.castling_rights[WHITE][1] = false;
+void NerdChess::board::undo_move(struct position& board, const struct undo& undo) {
+	if(undo.promotion) {
+		bitb::clear_bit(board.pieces[undo.promotion], undo.to);
+		bitb::set_bit(board.pieces[undo.piece], undo.from);
+	} else {
+		bitb::move_bit(board.pieces[undo.piece], undo.to, undo.from);
 	}
+	if(undo.captured >= 0)
+		bitb::set_bit(board.pieces[undo.captured], undo.capture_square);
+
+	// Put the rook back after castling
+	if(undo.piece == KING || undo.piece == KING+_BLACK) {
+		const int rook = undo.piece == KING ? ROOK : ROOK+_BLACK;
+		if(undo.to - undo.from == 2)
+			bitb::move_bit(board.pieces[rook], undo.to - 1, undo.from + 3);
+		if(undo.from - undo.to == 2)
+			bitb::move_bit(board.pieces[rook], undo.to + 1, undo.from - 4);
+	}
+
+	board.key = undo.key;
+	board.castling = undo.castling;
+	board.en_pessant = undo.en_pessant;
+	board.side = undo.side;
+	board.halfmove_clock = undo.halfmove_clock;
+}
+
+uint64_t NerdChess::board::compute_key(const struct position& board) {
+	uint64_t key = zobrist.castling[board.castling] ^ zobrist.en_pessant[board.en_pessant];
+	for(int i = 0; i < 12; ++i)
+		for(NerdChess::bitb::bitboard b = board.pieces[i]; b; )
+			key ^= zobrist.pieces[i][NerdChess::bitb::pop_lsb(b)];
+	if(board.side)
+		key ^= zobrist.side;
+	return key;
 }
 
 NerdChess::bitb::bitboard NerdChess::board::map_bitboard(std::vector<int> vec) {
@@ -122,25 +247,33 @@ NerdChess::bitb::bitboard NerdChess::board::map_bitboard(std::vector<int> vec) {
 	return bb;
 }
 
-NerdChess::bitb::bitboard NerdChess::board::get_control_map(struct position board, bool piece_color) {
-	NerdChess::bitb::bitboard map = 0ULL;
-	int piece;
-	for(int i = 0; i < 64; ++i) {
-		piece = get_piece_type(board, i);
-		if(piece != EMPTY && !((get_full_piece_type(board, i) - 6) < 0) == piece_color)
-			map |= map_bitboard(get_moves(board, i, piece, piece_color, true));
-	}
-	return map;
+// Every square a piece of color Us attacks. All pieces of a kind are handled at once (see setwise.h),
+// so this takes the same time however many pieces there are.
+template<bool Us>
+NerdChess::bitb::bitboard NerdChess::board::get_control_map(const struct position& board) {
+	constexpr int offset = Us ? _BLACK : 0;
+	const NerdChess::bitb::bitboard* pieces = board.pieces + offset;
+	return NerdChess::setwise::pawn_attacks<Us>(pieces[PAWN])
+		| NerdChess::setwise::knight_attacks(pieces[KNIGHT])
+		| NerdChess::setwise::slider_attacks(pieces[BISHOP] | pieces[QUEEN], pieces[ROOK] | pieces[QUEEN], map_pieces(board))
+		| NerdChess::setwise::king_attacks(pieces[KING]);
 }
 
-NerdChess::bitb::bitboard NerdChess::board::map_pieces(struct NerdChess::board::position board) {
+template NerdChess::bitb::bitboard NerdChess::board::get_control_map<WHITE>(const struct position&);
+template NerdChess::bitb::bitboard NerdChess::board::get_control_map<BLACK>(const struct position&);
+
+NerdChess::bitb::bitboard NerdChess::board::get_control_map(const struct position& board, bool piece_color) {
+	return piece_color ? get_control_map<BLACK>(board) : get_control_map<WHITE>(board);
+}
+
+NerdChess::bitb::bitboard NerdChess::board::map_pieces(const struct NerdChess::board::position& board) {
 	NerdChess::bitb::bitboard map = 0ULL;
 	for(int i = 0; i < 12; ++i)
 		map |= board.pieces[i];
 	return map;
 }
 
-NerdChess::bitb::bitboard NerdChess::board::map_pieces(struct NerdChess::board::position board, bool pieceColor) {
+NerdChess::bitb::bitboard NerdChess::board::map_pieces(const struct NerdChess::board::position& board, bool pieceColor) {
 	NerdChess::bitb::bitboard map = 0ULL;
 	if(pieceColor) {
 		for(int i = 6; i < 12; ++i)
@@ -160,474 +293,142 @@ int NerdChess::board::count_bits(NerdChess::bitb::bitboard bb) {
 	return num_bits;
 }
 
-int NerdChess::board::count_pieces(struct NerdChess::board::position board) {
+int NerdChess::board::count_pieces(const struct NerdChess::board::position& board) {
 	NerdChess::bitb::bitboard map = 0ULL;
 	for(int i = 0; i < 12; ++i)
 		map |= board.pieces[i];
 	return count_bits(map);
 }
 
-std::vector<int> NerdChess::board::get_moves(struct position pos, uint8_t piece_location, uint8_t piece_type, bool piece_color, bool control) {
+// Walks from piece_location in the direction given by df (file) and dr (rank) until the edge of the board or
+// the first piece. When generating moves the blocking piece is only included if it can be captured.
+template<NerdChess::board::gen_type Gen>
+static inline void slide(std::vector<int>& moves, int piece_location, int df, int dr, bitboard piece_map, bitboard enemy_map) {
+	int file = GET_FILE(piece_location) + df;
+	int rank = GET_RANK(piece_location) + dr;
+	while(file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+		const int i = rank * 8 + file;
+		if(Gen == NerdChess::board::GEN_CONTROL || !get_bit(piece_map, i) || get_bit(enemy_map, i))
+			moves.push_back(i);
+		if(get_bit(piece_map, i))
+			break;
+		file += df;
+		rank += dr;
+	}
+}
+
+// Adds the square at piece_location + (df, dr) if it is on the board and (when generating moves) not occupied by a friendly piece
+template<NerdChess::board::gen_type Gen>
+static inline void step(std::vector<int>& moves, int piece_location, int df, int dr, bitboard piece_map, bitboard enemy_map) {
+	const int file = GET_FILE(piece_location) + df;
+	const int rank = GET_RANK(piece_location) + dr;
+	if(file < 0 || file > 7 || rank < 0 || rank > 7)
+		return;
+	const int i = rank * 8 + file;
+	if(Gen == NerdChess::board::GEN_CONTROL || !get_bit(piece_map, i) || get_bit(enemy_map, i))
+		moves.push_back(i);
+}
+
+// Side to move (Us) and generation mode (Gen) are template parameters so that each of the four
+// instantiations below is compiled without the color/mode branches and with fixed pawn offsets.
+template<bool Us, NerdChess::board::gen_type Gen>
+std::vector<int> NerdChess::board::get_moves(const struct position& pos, uint8_t piece_location, uint8_t piece_type) {
+	constexpr int up = (Us == WHITE) ? -8 : 8; // Direction in which the pawns of this color move
+	constexpr int start_rank = (Us == WHITE) ? 6 : 1; // Rank from which pawns may move 2 squares
+	constexpr int last_rank = (Us == WHITE) ? 0 : 7; // Promotion rank
 	std::vector<int> legal_moves; // Vector of legal moves
-	const uint8_t opposite_piece_color = !piece_color; // This is used to determine what types of pieces the selected piece is allowed to capture
-	bitboard piece_map = map_pieces(pos); // Squares on which there are pieces
+	const bitboard piece_map = map_pieces(pos); // Squares on which there are pieces
+	const bitboard enemy_map = map_pieces(pos, !Us); // Pieces the selected piece is allowed to capture
+	const int file = GET_FILE(piece_location);
+	const int rank = GET_RANK(piece_location);
+
 	switch(piece_type) {
 		case PAWN:
-			if(!control) {
-				if(!piece_color) {
-					// White pawns
-					if(pos.en_pessant_squares[WHITE] >= 0 && ((piece_location - 9) == pos.en_pessant_squares[WHITE] || (piece_location - 7) == pos.en_pessant_squares[WHITE]))
-						legal_moves.push_back(pos.en_pessant_squares[WHITE]); // En pessant
-					if(!NerdChess::bitb::get_bit(piece_map, piece_location - 8) && piece_location > 7)
-						legal_moves.push_back(piece_location - 8); // 1 square forward
-					if(!NerdChess::bitb::get_bit(piece_map, piece_location - 16) && !get_bit(piece_map, piece_location - 8) && piece_location <= 55 && piece_location >= 48)
-						legal_moves.push_back(piece_location - 16); // 2 squares forward (if the pawn is still on it's starting square)
-					if(piece_color_at(pos, piece_location - 9, opposite_piece_color) && piece_location % 8 != 0)
-						legal_moves.push_back(piece_location - 9); // Piece capture (left)
-					if(piece_color_at(pos, piece_location - 7, opposite_piece_color) && (piece_location+1) % 8 != 0)
-						legal_moves.push_back(piece_location - 7); // Piece capture (right)
-				} else {
-					// Black pawns
-					if(pos.en_pessant_squares[BLACK] >= 0 && ((piece_location + 9) == pos.en_pessant_squares[BLACK] || (piece_location + 7) == pos.en_pessant_squares[BLACK]))
-						legal_moves.push_back(pos.en_pessant_squares[BLACK]); // En pessant
-					if(NerdChess::bitb::get_bit(piece_map, piece_location + 8) == 0 && piece_location < 56)
-						legal_moves.push_back(piece_location + 8); // 1 square forward
-					if(NerdChess::bitb::get_bit(piece_map, piece_location + 16) == 0 && get_bit(piece_map, piece_location + 8) == 0 && piece_location <= 15 && piece_location >= 8)
-						legal_moves.push_back(piece_location + 16); // 2 squares forward (if the pawn is still on it's starting square)
-					if(piece_color_at(pos, piece_location + 7, opposite_piece_color) && piece_location % 8 != 0)
-						legal_moves.push_back(piece_location + 7); // Piece capture (left)
-					if(piece_color_at(pos, piece_location + 9, opposite_piece_color) && (piece_location+1) % 8 != 0)
-						legal_moves.push_back(piece_location + 9); // Piece capture (right)
-				}
-			} else {
-				if(!piece_color) {
-					// White pawns
-					if(piece_location % 8 != 0)
-						legal_moves.push_back(piece_location - 9); // Piece capture (left)
-					if((piece_location+1) % 8 != 0)
-						legal_moves.push_back(piece_location - 7); // Piece capture (right)
-				} else {
-					// Black pawns
-					if(piece_location % 8 != 0)
-						legal_moves.push_back(piece_location + 7); // Piece capture (left)
-					if((piece_location+1) % 8 != 0)
-						legal_moves.push_back(piece_location + 9); // Piece capture (right)
-				}
-			}
+			if(rank == last_rank)
+				break;
+			if(Gen == GEN_MOVES) {
+				const int ep = pos.en_pessant_square(Us);
+				if(ep >= 0 && ((file != 0 && piece_location + up - 1 == ep) || (file != 7 && piece_location + up + 1 == ep)))
+					legal_moves.push_back(ep); // En pessant
+				if(!get_bit(piece_map, piece_location + up)) {
+					legal_moves.push_back(piece_location + up); // 1 square forward
+					if(rank == start_rank && !get_bit(piece_map, piece_location + 2*up))
+						legal_moves.push_back(piece_location + 2*up); // 2 squares forward (if the pawn is still on it's starting square)
+				}
+			}
+			if(file != 0 && (Gen == GEN_CONTROL || get_bit(enemy_map, piece_location + up - 1)))
+				legal_moves.push_back(piece_location + up - 1); // Piece capture (left)
+			if(file != 7 && (Gen == GEN_CONTROL || get_bit(enemy_map, piece_location + up + 1)))
+				legal_moves.push_back(piece_location + up + 1); // Piece capture (right)
 		break;
 
 		case KNIGHT:
-		if(!control) {
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location - 15) || piece_color_at(pos, piece_location - 15, opposite_piece_color)) && (piece_location+1) % 8 != 0 && piece_location > 15)
-				legal_moves.push_back(piece_location - 15); // 2 up, 1 right
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location - 17) || piece_color_at(pos, piece_location - 17, opposite_piece_color)) && piece_location % 8 != 0 && piece_location > 15)
-				legal_moves.push_back(piece_location - 17); // 2 up, 1 left
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location - 6) || piece_color_at(pos, piece_location - 6, opposite_piece_color)) && (piece_location+2) % 8 != 0 && (piece_location+1) % 8 != 0 && piece_location > 7)
-				legal_moves.push_back(piece_location - 6); // 1 up, 2 right
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location - 10) || piece_color_at(pos, piece_location - 10, opposite_piece_color)) && piece_location % 8 != 0 && (piece_location-1) % 8 != 0 && piece_location > 7)
-				legal_moves.push_back(piece_location - 10); // 1 up, 2 left
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location + 10) || piece_color_at(pos, piece_location + 10, opposite_piece_color)) && (piece_location+2) % 8 != 0 && (piece_location+1) % 8 != 0 && piece_location < 56)
-				legal_moves.push_back(piece_location + 10); // 1 down, 2 right
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location + 6) || piece_color_at(pos, piece_location + 6, opposite_piece_color)) && (piece_location % 8) != 0 && (piece_location-1) % 8 != 0 && piece_location < 56)
-				legal_moves.push_back(piece_location + 6); // 1 down, 2 left
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location + 17) || piece_color_at(pos, piece_location + 17, opposite_piece_color)) && (piece_location+1) % 8 != 0 && piece_location < 48)
-				legal_moves.push_back(piece_location + 17); // 2 down, 1 right
-			if((!NerdChess::bitb::get_bit(piece_map, piece_location + 15) || piece_color_at(pos, piece_location + 15, opposite_piece_color)) && (piece_location % 8) != 0 && piece_location < 48)
-				legal_moves.push_back(piece_location + 15); // 2 down, 1 left
-		} else {
-			if((piece_location+1) % 8 != 0 && piece_location > 15)
-				legal_moves.push_back(piece_location - 15); // 2 up, 1 right
-			if(piece_location % 8 != 0 && piece_location > 15)
-				legal_moves.push_back(piece_location - 17); // 2 up, 1 left
-			if((piece_location+2) % 8 != 0 && (piece_location+1) % 8 != 0 && piece_location > 7)
-				legal_moves.push_back(piece_location - 6); // 1 up, 2 right
-			if((piece_location % 8) != 0 && (piece_location-1) % 8 != 0 && piece_location > 7)
-				legal_moves.push_back(piece_location - 10); // 1 up, 2 left
-			if((piece_location+2) % 8 != 0 && (piece_location+1) % 8 != 0 && piece_location < 56)
-				legal_moves.push_back(piece_location + 10); // 1 down, 2 right
-			if((piece_location % 8) != 0 && (piece_location-1) % 8 != 0 && piece_location < 56)
-				legal_moves.push_back(piece_location + 6); // 1 down, 2 left
-			if((piece_location+1) % 8 != 0 && piece_location < 48)
-				legal_moves.push_back(piece_location + 17); // 2 down, 1 right
-			if((piece_location % 8) != 0 && piece_location < 48)
-				legal_moves.push_back(piece_location + 15); // 2 down, 1 left
-		}
+			step<Gen>(legal_moves, piece_location, 1, -2, piece_map, enemy_map); // 2 up, 1 right
+			step<Gen>(legal_moves, piece_location, -1, -2, piece_map, enemy_map); // 2 up, 1 left
+			step<Gen>(legal_moves, piece_location, 2, -1, piece_map, enemy_map); // 1 up, 2 right
+			step<Gen>(legal_moves, piece_location, -2, -1, piece_map, enemy_map); // 1 up, 2 left
+			step<Gen>(legal_moves, piece_location, 2, 1, piece_map, enemy_map); // 1 down, 2 right
+			step<Gen>(legal_moves, piece_location, -2, 1, piece_map, enemy_map); // 1 down, 2 left
+			step<Gen>(legal_moves, piece_location, 1, 2, piece_map, enemy_map); // 2 down, 1 right
+			step<Gen>(legal_moves, piece_location, -1, 2, piece_map, enemy_map); // 2 down, 1 left
 		break;
 
 		case BISHOP:
-		if(!control) {
-			// North-west
-			if(piece_location > 7 && (piece_location % 8) != 0) {
-				int i = piece_location - 9;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 == 0)
-						break;
-					i -= 9;
-				}
-			}
-			// South-east
-			if(piece_location < 56 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location + 9;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i >= 56 || (i+1) % 8 == 0)
-						break;
-					i += 9;
-				}
-			}
-			// North-east
-			if(piece_location > 7 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location - 7;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || (i+1) % 8 == 0)
-						break;
-					i -= 7;
-				}
-			}
-
-			// South-west
-			if(piece_location < 56 && (piece_location % 8) != 0) {
-				int i = piece_location + 7;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 == 0 || i >= 56)
-						break;
-					i += 7;
-				}
-			}
-		} else {
-			// North-west
-			if(piece_location > 7 && (piece_location % 8) != 0) {
-				int i = piece_location - 9;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 == 0)
-						break;
-					i -= 9;
-				}
-			}
-			// South-east
-			if(piece_location < 56 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location + 9;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i >= 56 || (i+1) % 8 == 0)
-						break;
-					i += 9;
-				}
-			}
-			// North-east
-			if(piece_location > 7 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location - 7;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || (i+1) % 8 == 0)
-						break;
-					i -= 7;
-				}
-			}
-
-			// South-west
-			if(piece_location < 56 && (piece_location % 8) != 0) {
-				int i = piece_location + 7;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 == 0)
-						break;
-					i += 7;
-				}
-			}
-		}
+			slide<Gen>(legal_moves, piece_location, -1, -1, piece_map, enemy_map); // North-west
+			slide<Gen>(legal_moves, piece_location, 1, 1, piece_map, enemy_map); // South-east
+			slide<Gen>(legal_moves, piece_location, 1, -1, piece_map, enemy_map); // North-east
+			slide<Gen>(legal_moves, piece_location, -1, 1, piece_map, enemy_map); // South-west
 		break;
 
 		case ROOK:
-		if(!control)
-		{
-			// Up
-			if(piece_location > 7) {
-				for(int i = piece_location - 8; i > -1; i -= 8) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Down
-			if(piece_location < 56) {
-				for(int i = piece_location + 8; i < 56; i += 8) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Left
-			if(piece_location % 8 != 0) {
-				for(int i = piece_location - 1; i > -1; --i) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 == 0)
-						break;
-				}
-			}
-			// Right
-			if((piece_location+1) % 8 != 0) {
-				for(int i = piece_location + 1; i < 63; ++i) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || (i+1) % 8 == 0)
-						break;
-				}
-			}
-		}
-		else
-		{
-			// Up
-			if(piece_location > 7) {
-				for(int i = piece_location - 8; i > -1; i -= 8) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Down
-			if(piece_location < 56) {
-				for(int i = piece_location + 8; i < 56; i += 8) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Left
-			if(piece_location % 8 != 0) {
-				for(int i = piece_location - 1; i > -1; --i) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 == 0)
-						break;
-				}
-			}
-			// Right
-			if((piece_location+1) % 8 != 0) {
-				for(int i = piece_location + 1; i < 63; ++i) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || (i+1) % 8 == 0)
-						break;
-				}
-			}
-		}
+			slide<Gen>(legal_moves, piece_location, 0, -1, piece_map, enemy_map); // Up
+			slide<Gen>(legal_moves, piece_location, 0, 1, piece_map, enemy_map); // Down
+			slide<Gen>(legal_moves, piece_location, -1, 0, piece_map, enemy_map); // Left
+			slide<Gen>(legal_moves, piece_location, 1, 0, piece_map, enemy_map); // Right
 		break;
 
 		case QUEEN:
-		if(!control) {
-			// ROOK MOVEMENT
-			// Up
-			if(piece_location > 7) {
-				for(int i = piece_location - 8; i > -1; i -= 8) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Down
-			if(piece_location < 56) {
-				for(int i = piece_location + 8; i < 56; i += 8) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Left
-			if(piece_location % 8 != 0) {
-				for(int i = piece_location - 1; i > -1; --i) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 == 0)
-						break;
-				}
-			}
-			// Right
-			if((piece_location+1) % 8 != 0) {
-				for(int i = piece_location + 1; i < 63; ++i) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || (i+1) % 8 == 0)
-						break;
-				}
-			}
-
-			// BISHOP MOVEMENT
-			// North-west
-			if(piece_location > 7 && (piece_location % 8) != 0) {
-				int i = piece_location - 9;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 == 0)
-						break;
-					i -= 9;
-				}
-			}
-			// South-east
-			if(piece_location < 56 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location + 9;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i >= 56 || (i+1) % 8 == 0)
-						break;
-					i += 9;
-				}
-			}
-			// North-east
-			if(piece_location > 7 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location - 7;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || (i+1) % 8 == 0)
-						break;
-					i -= 7;
-				}
-			}
-
-			// South-west
-			if(piece_location < 56 && (piece_location % 8) != 0) {
-				int i = piece_location + 7;
-				while(1) {
-					if(!NerdChess::bitb::get_bit(piece_map, i) || piece_color_at(pos, i, opposite_piece_color))
-						legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 != 0 || i >= 56)
-						break;
-					i += 7;
-				}
-			}
-		} else {
 			// ROOK MOVEMENT
-			// Up
-			if(piece_location > 7) {
-				for(int i = piece_location - 8; i > -1; i -= 8) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Down
-			if(piece_location < 56) {
-				for(int i = piece_location + 8; i < 56; i += 8) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i))
-						break;
-				}
-			}
-			// Left
-			if(piece_location % 8 != 0) {
-				for(int i = piece_location - 1; i > -1; --i) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i % 8 == 0)
-						break;
-				}
-			}
-			// Right
-			if((piece_location+1) % 8 != 0) {
-				for(int i = piece_location + 1; i < 63; ++i) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || (i+1) % 8 == 0)
-						break;
-				}
-			}
-
+			slide<Gen>(legal_moves, piece_location, 0, -1, piece_map, enemy_map); // Up
+			slide<Gen>(legal_moves, piece_location, 0, 1, piece_map, enemy_map); // Down
+			slide<Gen>(legal_moves, piece_location, -1, 0, piece_map, enemy_map); // Left
+			slide<Gen>(legal_moves, piece_location, 1, 0, piece_map, enemy_map); // Right
 			// BISHOP MOVEMENT
-			// North-west
-			if(piece_location > 7 && (piece_location % 8) != 0) {
-				int i = piece_location - 9;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 == 0)
-						break;
-					i -= 9;
-				}
-			}
-			// South-east
-			if(piece_location < 56 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location + 9;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i >= 56 || (i+1) % 8 == 0)
-						break;
-					i += 9;
-				}
-			}
-			// North-east
-			if(piece_location > 7 && ((piece_location+1) % 8) != 0) {
-				int i = piece_location - 7;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || (i+1) % 8 == 0)
-						break;
-					i -= 7;
-				}
-			}
-
-			// South-west
-			if(piece_location < 56 && (piece_location % 8) != 0) {
-				int i = piece_location + 7;
-				while(1) {
-					legal_moves.push_back(i);
-					if(NerdChess::bitb::get_bit(piece_map, i) || i < 8 || i % 8 != 0)
-						break;
-					i += 7;
-				}
-			}
-		}
+			slide<Gen>(legal_moves, piece_location, -1, -1, piece_map, enemy_map); // North-west
+			slide<Gen>(legal_moves, piece_location, 1, 1, piece_map, enemy_map); // South-east
+			slide<Gen>(legal_moves, piece_location, 1, -1, piece_map, enemy_map); // North-east
+			slide<Gen>(legal_moves, piece_location, -1, 1, piece_map, enemy_map); // South-west
 		break;
 
 		case KING:
-		if(!control) {
-			const NerdChess::bitb::bitboard enemyControlMap = NerdChess::board::get_control_map(pos, opposite_piece_color);
-			const NerdChess::bitb::bitboard illegalSquares = enemyControlMap | NerdChess::board::map_pieces(pos, piece_color);
-			const NerdChess::bitb::bitboard blockedCastleSquaresMap = piece_map | enemyControlMap;
-
-			// Loops in a way that creates a 3x3 area around the piece_location (ignores piece_locations itself since the king can't control it's own square)
-			for(int i = piece_location - 9; i < piece_location + 9; i += 8) {
-				for(int j = 0; j < 3; ++j) {
-					if(i+j != piece_location && i+j >= 0 && i+j < 64) {
-						if(!NerdChess::bitb::get_bit(illegalSquares, i+j)) {
-							legal_moves.push_back(i+j);
-						}
-					}
-				}
-			}
+		if(Gen == GEN_MOVES) {
+			const bitboard enemyControlMap = get_control_map<!Us>(pos);
+			const bitboard illegalSquares = enemyControlMap | map_pieces(pos, Us);
+			const bitboard blockedCastleSquaresMap = piece_map | enemyControlMap;
+
+			// 3x3 area around the piece_location (the king can't control it's own square)
+			for(int dr = -1; dr <= 1; ++dr)
+				for(int df = -1; df <= 1; ++df)
+					if((df || dr) && file + df >= 0 && file + df < 8 && rank + dr >= 0 && rank + dr < 8)
+						if(!get_bit(illegalSquares, piece_location + dr*8 + df))
+							legal_moves.push_back(piece_location + dr*8 + df);
 
 			// Castling
-			if(pos.castling_rights[piece_color][0]) {
+			if(pos.can_castle(Us, 0)) {
 				// King-side castle
-				if(!(bitb::get_bit(blockedCastleSquaresMap, piece_location+1) | bitb::get_bit(blockedCastleSquaresMap, piece_location+2))) {
+				if(!(get_bit(blockedCastleSquaresMap, piece_location+1) | get_bit(blockedCastleSquaresMap, piece_location+2)))
 					legal_moves.push_back(piece_location + 2);
-				}
 			}
-			if(pos.castling_rights[piece_color][1]) {
+			if(pos.can_castle(Us, 1)) {
 				// Queen-side castle
-				if(!(bitb::get_bit(blockedCastleSquaresMap, piece_location-1) | bitb::get_bit(blockedCastleSquaresMap, piece_location-2) | bitb::get_bit(blockedCastleSquaresMap, piece_location-3))) {
+				if(!(get_bit(blockedCastleSquaresMap, piece_location-1) | get_bit(blockedCastleSquaresMap, piece_location-2) | get_bit(blockedCastleSquaresMap, piece_location-3)))
 					legal_moves.push_back(piece_location - 2);
-				}
 			}
 		} else {
-			// Loops in a way that creates a 3x3 area around the piece_location (ignores piece_locations itself since the king can't control it's own square)
-			for(int i = piece_location - 9; i < piece_location + 9; i += 8) {
-				for(int j = 0; j < 3; ++j) {
-					if(i+j != piece_location && i+j >= 0 && i+j < 64) {
-						legal_moves.push_back(i+j);
-					}
-				}
-			}
+			for(int dr = -1; dr <= 1; ++dr)
+				for(int df = -1; df <= 1; ++df)
+					if((df || dr) && file + df >= 0 && file + df < 8 && rank + dr >= 0 && rank + dr < 8)
+						legal_moves.push_back(piece_location + dr*8 + df);
 		}
 		break;
 
@@ -639,13 +440,22 @@ std::vector<int> NerdChess::board::get_moves(struct position pos, uint8_t piece_
 	return legal_moves;
 }
 
+template std::vector<int> NerdChess::board::get_moves<WHITE, NerdChess::board::GEN_MOVES>(const struct position&, uint8_t, uint8_t);
+template std::vector<int> NerdChess::board::get_moves<WHITE, NerdChess::board::GEN_CONTROL>(const struct position&, uint8_t, uint8_t);
+template std::vector<int> NerdChess::board::get_moves<BLACK, NerdChess::board::GEN_MOVES>(const struct position&, uint8_t, uint8_t);
+template std::vector<int> NerdChess::board::get_moves<BLACK, NerdChess::board::GEN_CONTROL>(const struct position&, uint8_t, uint8_t);
+
+std::vector<int> NerdChess::board::get_moves(const struct position& pos, uint8_t piece_location, uint8_t piece_type, bool piece_color, bool control) {
+	if(!piece_color)
+		return control ? get_moves<WHITE, GEN_CONTROL>(pos, piece_location, piece_type) : get_moves<WHITE, GEN_MOVES>(pos, piece_location, piece_type);
+	return control ? get_moves<BLACK, GEN_CONTROL>(pos, piece_location, piece_type) : get_moves<BLACK, GEN_MOVES>(pos, piece_location, piece_type);
+}
+
 void NerdChess::board::setup_position(struct position& board) {
-	board.castling_rights[WHITE][0] = true;
-	board.castling_rights[WHITE][1] = true;
-	board.castling_rights[BLACK][0] = true;
-	board.castling_rights[BLACK][1] = true;
-	board.en_pessant_squares[WHITE] = INT_MIN;
-	board.en_pessant_squares[BLACK] = INT_MIN;
+	board.castling = 15;
+	board.en_pessant = NO_SQUARE;
+	board.side = WHITE;
+	board.halfmove_clock = 0;
 
 	for(int i = 0; i < 12; ++i)
 		board.pieces[i] = 0ULL;
@@ -687,6 +497,58 @@ void NerdChess::board::setup_position(struct position& board) {
 	// King
 	NerdChess::bitb::set_bit(board.pieces[5], 60); // White king
 	NerdChess::bitb::set_bit(board.pieces[11], 4); // Black king
+
+	board.key = compute_key(board);
+}
+
+// Loads a position from FEN. Returns false if the string could not be parsed.
+bool NerdChess::board::load_fen(struct position& board, const std::string& fen, bool& side_to_move) {
+	const std::string piece_chars = "PNBRQKpnbrqk";
+	std::istringstream stream(fen);
+	std::string placement, side, castling, en_pessant;
+	stream >> placement >> side >> castling >> en_pessant;
+	if(placement.empty())
+		return false;
+
+	board = get_empty_position();
+
+	int square = 0;
+	for(char c : placement) {
+		if(c == '/')
+			continue;
+		if(c >= '1' && c <= '8') {
+			square += c - '0';
+		} else {
+			const size_t piece = piece_chars.find(c);
+			if(piece == std::string::npos || square > 63)
+				return false;
+			NerdChess::bitb::set_bit(board.pieces[piece], square++);
+		}
+	}
+	if(square != 64)
+		return false;
+
+	side_to_move = (side == "b") ? BLACK : WHITE;
+	for(char c : castling) {
+		if(c == 'K') board.set_castling(WHITE, 0, true);
+		if(c == 'Q') board.set_castling(WHITE, 1, true);
+		if(c == 'k') board.set_castling(BLACK, 0, true);
+		if(c == 'q') board.set_castling(BLACK, 1, true);
+	}
+	if(en_pessant.size() == 2 && en_pessant[0] >= 'a' && en_pessant[0] <= 'h' && en_pessant[1] >= '1' && en_pessant[1] <= '8') {
+		// Like move_piece, only keep the square if a pawn can actually take there (otherwise equal positions would hash differently)
+		const int file = en_pessant[0] - 'a';
+		const int pawn_rank = side_to_move ? 32 : 24; // First square of the rank the pawn which just moved is on
+		const NerdChess::bitb::bitboard pawns = board.pieces[side_to_move ? PAWN+_BLACK : PAWN];
+		if((file > 0 && get_bit(pawns, pawn_rank + file - 1)) || (file < 7 && get_bit(pawns, pawn_rank + file + 1)))
+			board.en_pessant = (8 - (en_pessant[1] - '0')) * 8 + file;
+	}
+	int halfmove_clock = 0;
+	if(stream >> halfmove_clock)
+		board.halfmove_clock = std::max(0, std::min(halfmove_clock, (int)UINT8_MAX));
+	board.side = side_to_move;
+	board.key = compute_key(board);
+	return true;
 }
 
 // Finds the piece (works best with only 1 present piece)
@@ -699,7 +561,7 @@ int NerdChess::board::find_piece(bitboard bb) {
 	return -1;
 }
 
-void NerdChess::board::print_board(struct position board, int sp, int ss) {
+void NerdChess::board::print_board(const struct position& board, int sp, int ss) {
 	const std::string piece_symbols[] = {"\033[97mp", "\033[97mN", "\033[97mB", "\033[97mR", "\033[97mQ", "\033[97mK", "\033[90mp", "\033[90mN", "\033[90mB", "\033[90mR", "\033[90mQ", "\033[90mK"};
 	for(int i = 0; i < 8; ++i) {
 		for(int j = 0; j < 8; ++j) {
@@ -720,7 +582,7 @@ void NerdChess::board::print_board(struct position board, int sp, int ss) {
 	std::cout << "\033[97m\n";
 }
 
-std::string NerdChess::board::board_to_str(NerdChess::board::position board) {
+std::string NerdChess::board::board_to_str(const NerdChess::board::position& board) {
     const char piece_chars[] = {'P', 'N', 'B', 'R', 'Q', 'K', 'p', 'n', 'b', 'r', 'q', 'k'};
     std::string str;
     for(int i = 0; i < 64; ++i) {
@@ -749,7 +611,7 @@ void NerdChess::board::debug::print_vec(std::vector<int> vec)
 }
 
 // Prints out the entire collection of bitboards as one board
-void NerdChess::board::debug::print_board(struct position board) {
+void NerdChess::board::debug::print_board(const struct position& board) {
 	const std::string piece_symbols[] = {"\033[97mp", "\033[97mN", "\033[97mB", "\033[97mR", "\033[97mQ", "\033[97mK", "\033[90mp", "\033[90mN", "\033[90mB", "\033[90mR", "\033[90mQ", "\033[90mK"};
 	for(int i = 0; i < 8; ++i) {
 		for(int j = 0; j < 8; ++j) {
@@ -3,6 +3,8 @@
 
 #include <iostream>
 #include <vector>
+#include <climits>
+#include <cstdint>
 #include "bitboard.h"
 
 #define GET_FILE(x) (x % 8)
@@ -19,39 +21,86 @@
 #define _BLACK 6
 #define WHITE 0
 #define BLACK 1
+#define NO_SQUARE 64
 
 using namespace NerdChess::bitb;
 
 namespace NerdChess {
 namespace board {
-struct position {
-	bitb::bitboard pieces[12];	
-	bool castling_rights[2][2];
-	int en_pessant_squares[2];
+// What get_moves generates: moves the piece can make, or every square the piece attacks
+// (including squares occupied by friendly pieces), which is used for control maps
+enum gen_type {
+	GEN_MOVES,
+	GEN_CONTROL
 };
 
-bool is_empty(struct position board, uint8_t square_location);
-bool piece_color_at(struct position board, uint8_t square_location, uint8_t piece_color);
-int get_piece_type(struct position board, uint8_t square_location);
-int get_full_piece_type(struct position board, uint8_t square_location);
+// Copied once per move by the search, so it is kept small: 12 bitboards, the hash key and 4 bytes
+// of state are 108 bytes, which is padded to exactly two cache lines.
+struct alignas(64) position {
+	bitb::bitboard pieces[12];
+	uint64_t key; // Zobrist hash, kept up to date by move_piece (see compute_key)
+	uint8_t castling; // Bit color * 2 + wing is set if that castling is still allowed
+	uint8_t en_pessant; // Square the side to move can take en pessant on, NO_SQUARE if none
+	uint8_t side; // Side to move
+	uint8_t halfmove_clock; // Plies since the last capture or pawn move
+
+	// wing is 0 for king-side and 1 for queen-side
+	bool can_castle(bool color, int wing) const { return castling & (1 << (color * 2 + wing)); }
+	void set_castling(bool color, int wing, bool allowed) {
+		if(allowed)
+			castling |= 1 << (color * 2 + wing);
+		else
+			castling &= ~(1 << (color * 2 + wing));
+	}
+	// The square color can take en pessant on, or INT_MIN. The rank tells whose it is.
+	int en_pessant_square(bool color) const { return en_pessant != NO_SQUARE && (en_pessant < 32) == !color ? en_pessant : INT_MIN; }
+};
+
+static_assert(sizeof(struct position) == 128, "position should take exactly two cache lines");
+
+// Everything move_piece changes besides the pieces that can't be worked out from the move itself,
+// so that undo_move can take the move back (make/unmake instead of copying the position)
+struct undo {
+	uint64_t key;
+	int8_t piece; // Piece which moved (0-11)
+	int8_t captured; // Piece which was taken (0-11), -1 if none
+	uint8_t from, to;
+	uint8_t capture_square; // Differs from to for en pessant
+	uint8_t promotion; // Piece the pawn turned into (0-11), 0 if none
+	uint8_t castling, en_pessant, side, halfmove_clock;
+};
+
+bool is_empty(const struct position& board, uint8_t square_location);
+bool piece_color_at(const struct position& board, uint8_t square_location, uint8_t piece_color);
+int get_piece_type(const struct position& board, uint8_t square_location);
+int get_full_piece_type(const struct position& board, uint8_t square_location);
 void remove_piece(struct position& board, int square_location);
-void move_piece(struct position& board, int from, int to);
+void move_piece(struct position& board, int from, int to, int promotion = QUEEN, struct undo* undo = nullptr);
+void undo_move(struct position& board, const struct undo& undo);
 bitb::bitboard map_bitboard(std::vector<int> vec);
-bitb::bitboard get_control_map(struct position board, bool piece_color);
-bitb::bitboard map_pieces(struct position board);
-bitb::bitboard map_pieces(struct position board, bool pieceColor);
+template<bool Us> bitb::bitboard get_control_map(const struct position& board);
+bitb::bitboard get_control_map(const struct position& board, bool piece_color);
+bitb::bitboard map_pieces(const struct position& board);
+bitb::bitboard map_pieces(const struct position& board, bool pieceColor);
 int count_bits(bitb::bitboard bb);
-int count_pieces(struct position board);
-std::vector<int> get_moves(struct position pos, uint8_t piece_location, uint8_t piece_type, bool piece_color, bool control);
+int count_pieces(const struct position& board);
+template<bool Us, gen_type Gen> std::vector<int> get_moves(const struct position& pos, uint8_t piece_location, uint8_t piece_type);
+std::vector<int> get_moves(const struct position& pos, uint8_t piece_location, uint8_t piece_type, bool piece_color, bool control);
 void setup_position(struct position& board);
+bool load_fen(struct position& board, const std::string& fen, bool& side_to_move);
+uint64_t compute_key(const struct position& board); // Hash from scratch, move_piece only updates it
 int find_piece(bitb::bitboard bb);
-inline struct position get_empty_position() { return (struct position){{0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL, 0ULL}, {true, true}, {INT_MIN, INT_MIN}}; }
-void print_board(struct position board, int sp, int ss);
-std::string board_to_str(NerdChess::board::position board);
+inline struct position get_empty_position() {
+	struct position board = {};
+	board.en_pessant = NO_SQUARE;
+	return board;
+}
+void print_board(const struct position& board, int sp, int ss);
+std::string board_to_str(const NerdChess::board::position& board);
 
 namespace debug {
 void print_vec(std::vector<int> vec);
-void print_board(struct position board);
+void print_board(const struct position& board);
 } // namespace debug
 } // namespace board
 } // namespace NerdChess
@@ -0,0 +1,321 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include "record.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const struct NerdChess::board::position standard_start = []() {
+    struct NerdChess::board::position pos = NerdChess::board::get_empty_position();
+    NerdChess::board::setup_position(pos);
+    return pos;
+}();
+
+static bool is_standard_start(const struct NerdChess::board::position& pos, bool side) {
+    return side == WHITE && std::memcmp(pos.pieces, standard_start.pieces, sizeof(pos.pieces)) == 0 && pos.castling == standard_start.castling
+        && pos.en_pessant == standard_start.en_pessant && pos.halfmove_clock == 0;
+}
+
+static void pack_start(const struct NerdChess::board::position& pos, bool side, std::vector<uint8_t>& out) {
+    const NerdChess::bitb::bitboard occupied = NerdChess::board::map_pieces(pos);
+    const size_t begin = out.size();
+    out.resize(begin + sizeof(occupied));
+    std::memcpy(&out[begin], &occupied, sizeof(occupied));
+    int nibble = 0;
+    for(NerdChess::bitb::bitboard bb = occupied; bb;) {
+        const int square = NerdChess::bitb::pop_lsb(bb);
+        const int piece = NerdChess::board::get_full_piece_type(pos, square);
+        if(nibble++ % 2 == 0)
+            out.push_back(piece);
+        else
+            out.back() |= piece << 4;
+    }
+    out.push_back(pos.castling);
+    out.push_back(pos.en_pessant);
+    out.push_back(side);
+    out.push_back(pos.halfmove_clock);
+}
+
+static size_t start_size(const uint8_t* p) {
+    NerdChess::bitb::bitboard occupied;
+    std::memcpy(&occupied, p, sizeof(occupied));
+    return sizeof(occupied) + (NerdChess::bitb::popcount(occupied) + 1) / 2 + 4;
+}
+
+static const uint8_t* unpack_start(const uint8_t* p, struct NerdChess::board::position& pos, bool& side) {
+    NerdChess::bitb::bitboard occupied;
+    std::memcpy(&occupied, p, sizeof(occupied));
+    p += sizeof(occupied);
+    pos = NerdChess::board::get_empty_position();
+    int nibble = 0;
+    for(NerdChess::bitb::bitboard bb = occupied; bb; ++nibble) {
+        const int square = NerdChess::bitb::pop_lsb(bb);
+        const int piece = nibble % 2 == 0 ? *p & 15 : *p++ >> 4;
+        if(piece < 12)
+            NerdChess::bitb::set_bit(pos.pieces[piece], square);
+    }
+    if(nibble % 2)
+        p++;
+    pos.castling = *p++;
+    pos.en_pessant = *p++;
+    side = *p++ & 1;
+    pos.halfmove_clock = *p++;
+    pos.side = side;
+    pos.key = NerdChess::board::compute_key(pos);
+    return p;
+}
+
+// Size of the game at p, 0 if it doesn't fit before end
+static size_t game_size(const uint8_t* p, const uint8_t* end) {
+    struct NerdChess::record::game_header header;
+    if(end - p < (ptrdiff_t)sizeof(header))
+        return 0;
+    std::memcpy(&header, p, sizeof(header));
+    size_t size = sizeof(header) + header.plies;
+    if(header.flags & RECORD_CUSTOM_START) {
+        if(end - p < (ptrdiff_t)(sizeof(header) + sizeof(NerdChess::bitb::bitboard)))
+            return 0;
+        size += start_size(p + sizeof(header));
+    }
+    return (size_t)(end - p) >= size ? size : 0;
+}
+
+// The move indices are resolved by generating the moves of every position, which is the whole cost of reading
+static bool decode(const uint8_t* p, struct NerdChess::record::game_header& header, struct NerdChess::pgn::game& g, bool replay) {
+    std::memcpy(&header, p, sizeof(header));
+    p += sizeof(header);
+    g.tags.clear();
+    g.moves.clear();
+    g.keys.clear();
+    g.error.clear();
+    g.result = header.result;
+    if(header.flags & RECORD_CUSTOM_START) {
+        p = unpack_start(p, g.start, g.start_side);
+    } else {
+        g.start = standard_start;
+        g.start_side = WHITE;
+    }
+    if(!replay)
+        return true;
+
+    struct NerdChess::board::position pos = g.start;
+    bool side = g.start_side;
+    g.moves.reserve(header.plies);
+    g.keys.reserve(header.plies + 1);
+    for(int ply = 0; ply < header.plies; ++ply) {
+        struct NerdChess::movegen::move_list list;
+        NerdChess::movegen::generate(pos, side, list);
+        if(p[ply] >= list.size) {
+            g.error = "Move index " + std::to_string(p[ply]) + " out of range at ply " + std::to_string(ply);
+            return false;
+        }
+        const NerdChess::movegen::move m = list.moves[p[ply]];
+        g.keys.push_back(pos.key);
+        g.moves.push_back(m);
+        NerdChess::movegen::make_move(pos, m);
+        side = !side;
+    }
+    g.keys.push_back(pos.key);
+    return true;
+}
+
+NerdChess::record::writer::~writer() {
+    close();
+}
+
+bool NerdChess::record::writer::open(const std::string& path) {
+    close();
+    std::error_code error;
+    const uintmax_t existing = std::filesystem::exists(path, error) ? std::filesystem::file_size(path, error) : 0;
+    if(existing > 0) {
+        // Games are only appended to a file of the same version, after the last complete one
+        struct reader r;
+        if(!r.open(path)) {
+            std::cerr << path << " is not a game record file of version " << RECORD_VERSION << "\n";
+            return false;
+        }
+        const size_t end = r.used();
+        r.close();
+        if(end < existing)
+            std::filesystem::resize_file(path, end, error);
+        if(error)
+            return false;
+    }
+
+    file.open(path, std::ios::binary | std::ios::app);
+    if(!file)
+        return false;
+    if(existing == 0) {
+        struct file_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "NCGAMES1", 8);
+        header.version = RECORD_VERSION;
+        file.write((const char*)&header, sizeof(header));
+    }
+    written = 0;
+    return (bool)file;
+}
+
+bool NerdChess::record::writer::write(const struct pgn::game& g, uint8_t white, uint8_t black, uint8_t termination) {
+    if(g.moves.size() > UINT16_MAX)
+        return false;
+    struct game_header header = {(uint16_t)g.moves.size(), (int8_t)g.result, 0, white, black, termination, 0};
+    const bool custom = !is_standard_start(g.start, g.start_side);
+    if(custom)
+        header.flags |= RECORD_CUSTOM_START;
+
+    std::vector<uint8_t> out(sizeof(header));
+    out.reserve(sizeof(header) + (custom ? 32 : 0) + g.moves.size());
+    std::memcpy(out.data(), &header, sizeof(header));
+    if(custom)
+        pack_start(g.start, g.start_side, out);
+
+    struct board::position pos = g.start;
+    bool side = g.start_side;
+    for(movegen::move m : g.moves) {
+        struct movegen::move_list list;
+        movegen::generate(pos, side, list);
+        const movegen::move* found = std::find(list.moves, list.moves + list.size, m);
+        if(found == list.moves + list.size)
+            return false;
+        out.push_back(found - list.moves);
+        movegen::make_move(pos, m);
+        side = !side;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!file.is_open())
+        return false;
+    file.write((const char*)out.data(), out.size());
+    written++;
+    return (bool)file;
+}
+
+bool NerdChess::record::writer::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    file.flush();
+    return (bool)file;
+}
+
+void NerdChess::record::writer::close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(file.is_open())
+        file.close();
+}
+
+NerdChess::record::reader::~reader() {
+    close();
+}
+
+bool NerdChess::record::reader::open(const std::string& path) {
+    close();
+#if !defined(_WIN32)
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED) {
+            data = (const uint8_t*)map;
+            bytes = st.st_size;
+            mapped = true;
+        }
+    }
+    if(fd >= 0)
+        ::close(fd);
+#endif
+    if(!mapped) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if(!file)
+            return false;
+        buffer.resize(file.tellg());
+        file.seekg(0);
+        file.read((char*)buffer.data(), buffer.size());
+        data = buffer.data();
+        bytes = buffer.size();
+    }
+
+    struct file_header header;
+    if(bytes < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if(std::memcmp(header.magic, "NCGAMES1", 8) != 0 || header.version != RECORD_VERSION) {
+        close();
+        return false;
+    }
+
+    // Only the headers are touched, but on a file of tiny games that still reads in most pages
+    size_t offset = sizeof(header);
+    while(offset < bytes) {
+        const size_t size = game_size(data + offset, data + bytes);
+        if(size == 0)
+            break;
+        if(count % RECORD_INDEX_STRIDE == 0)
+            index.push_back(offset);
+        offset += size;
+        count++;
+    }
+    end = offset;
+    return true;
+}
+
+void NerdChess::record::reader::close() {
+#if !defined(_WIN32)
+    if(mapped)
+        munmap((void*)data, bytes);
+#endif
+    data = nullptr;
+    bytes = 0;
+    end = 0;
+    mapped = false;
+    buffer.clear();
+    index.clear();
+    count = 0;
+}
+
+bool NerdChess::record::reader::read(uint64_t game, struct game_header& header, struct pgn::game& g) const {
+    if(game >= count)
+        return false;
+    size_t offset = index[game / RECORD_INDEX_STRIDE];
+    for(uint64_t skip = game % RECORD_INDEX_STRIDE; skip > 0; --skip)
+        offset += game_size(data + offset, data + end);
+    return decode(data + offset, header, g, true);
+}
+
+uint64_t NerdChess::record::reader::scan(int threads, const std::function<void(const struct game_header&, const struct pgn::game&)>& on_game, bool replay) const {
+    std::atomic<size_t> next_block(0);
+    std::atomic<uint64_t> bad(0);
+    const auto worker = [&]() {
+        struct game_header header;
+        struct pgn::game g;
+        for(size_t block = next_block++; block < index.size(); block = next_block++) {
+            size_t offset = index[block];
+            const uint64_t last = std::min<uint64_t>(count, (block + 1) * (uint64_t)RECORD_INDEX_STRIDE);
+            for(uint64_t game = block * (uint64_t)RECORD_INDEX_STRIDE; game < last; ++game) {
+                if(!decode(data + offset, header, g, replay))
+                    bad++;
+                if(on_game)
+                    on_game(header, g);
+                offset += game_size(data + offset, data + end);
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int i = 1; i < threads; ++i)
+        pool.emplace_back(worker);
+    worker();
+    for(std::thread& thread : pool)
+        thread.join();
+    return bad;
+}
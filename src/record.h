@@ -0,0 +1,116 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include "pgn.h"
+
+#define RECORD_VERSION 1
+#define RECORD_INDEX_STRIDE 1024 // Games between two entries of the reader's index
+
+// game_header::flags
+#define RECORD_CUSTOM_START 1 // The header is followed by the start position, otherwise it is the standard one
+
+// game_header::termination
+#define RECORD_END_UNKNOWN 0
+#define RECORD_END_MATE 1
+#define RECORD_END_STALEMATE 2
+#define RECORD_END_REPETITION 3
+#define RECORD_END_FIFTY_MOVES 4
+#define RECORD_END_MATERIAL 5 // Insufficient material
+#define RECORD_END_TIME 6
+#define RECORD_END_MAX_PLIES 7 // Adjudicated a draw after too many moves
+
+namespace NerdChess {
+namespace record {
+// Binary game records, for the millions of games the match runner and others play, which would take far
+// longer to parse back from PGN. A file is a file_header followed by the games, appended one after the other:
+//
+//     game_header  8 bytes
+//     start        only with RECORD_CUSTOM_START: occupied squares (8 bytes), the piece on each of them in
+//                  square order (4 bits each, rounded up to whole bytes), castling, en pessant square, side to
+//                  move and halfmove clock (a byte each)
+//     moves        one byte per ply, the index of the move in movegen::generate's list of the position
+//
+// There are never more than 218 legal moves, so a byte is always enough. The move indices depend on the
+// order generate() lists the moves in, RECORD_VERSION has to go up if that ever changes. A game which was
+// only partly written (the writer was killed) ends the file for the reader.
+struct file_header {
+    char magic[8]; // "NCGAMES1"
+    uint32_t version; // RECORD_VERSION
+    uint32_t reserved;
+};
+
+struct game_header {
+    uint16_t plies;
+    int8_t result; // RESULT_* (pgn.h)
+    uint8_t flags; // RECORD_*
+    uint8_t white; // Player ids, whatever the writer numbers its players with (e.g. engine A and B of a match)
+    uint8_t black;
+    uint8_t termination; // RECORD_END_*
+    uint8_t reserved;
+};
+
+static_assert(sizeof(struct file_header) == 16, "record file header must be 16 bytes");
+static_assert(sizeof(struct game_header) == 8, "record game header must be 8 bytes");
+
+// Appends games to a file, from any number of threads
+struct writer {
+    writer() = default;
+    ~writer(); // Flushes and closes
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    // Appends to path, which is created if it doesn't exist yet. Fails if it isn't a record file of this version.
+    bool open(const std::string& path);
+    // False if a move of g isn't legal (nothing is written then) or the file couldn't be written
+    bool write(const struct pgn::game& g, uint8_t white = 0, uint8_t black = 0, uint8_t termination = RECORD_END_UNKNOWN);
+    bool flush();
+    void close();
+    uint64_t games() const { return written; } // Written since open()
+
+private:
+    std::ofstream file;
+    std::mutex mutex;
+    uint64_t written = 0;
+};
+
+// Read-only view of a record file, memory mapped where possible. open() walks through the game headers once
+// and remembers where every RECORD_INDEX_STRIDE-th game starts, so that any game can be found by skipping
+// at most that many headers.
+struct reader {
+    reader() = default;
+    ~reader();
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    uint64_t size() const { return count; } // Number of games
+    size_t used() const { return end; } // Bytes up to the end of the last complete game
+
+    // One game (numbered from 0) with its moves replayed, g.keys included as in pgn::parse_game. False if the game
+    // doesn't exist or has a move which isn't legal (g.error says which).
+    bool read(uint64_t game, struct game_header& header, struct pgn::game& g) const;
+    // Goes through every game on threads threads, see pgn::read_file: on_game is called from the workers in no
+    // particular order. Without replay only the headers are read (g only has its result and start position),
+    // which is all a count of the results needs. Returns the number of games with an illegal move.
+    uint64_t scan(int threads, const std::function<void(const struct game_header&, const struct pgn::game&)>& on_game, bool replay = true) const;
+
+private:
+    const uint8_t* data = nullptr;
+    size_t bytes = 0;
+    size_t end = 0;
+    bool mapped = false;
+    std::vector<uint8_t> buffer; // The file, if it couldn't be mapped
+    std::vector<size_t> index; // Offset of every RECORD_INDEX_STRIDE-th game
+    uint64_t count = 0;
+};
+} // namespace record
+} // namespace NerdChess
+
+#endif
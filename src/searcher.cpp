@@ -0,0 +1,66 @@
+#include <iostream>
+#include "searcher.h"
+
+NerdChess::engine::searcher::searcher() : stop_flag(false), busy(false), last_info{0, 0, {}, 0, 0, {}} {}
+
+NerdChess::engine::searcher::~searcher() {
+    stop();
+    if(result.valid())
+        result.wait();
+}
+
+std::shared_future<struct NerdChess::engine::engine_eval> NerdChess::engine::searcher::start(const struct board::position& pos, bool side, const struct search_limits& limits,
+                                                                                           const struct config& cfg, std::function<void(const struct search_info&)> on_progress,
+                                                                                           std::vector<uint64_t> history) {
+    stop();
+    if(result.valid())
+        result.wait();
+    stop_flag = false;
+    busy = true;
+    {
+        std::lock_guard<std::mutex> lock(info_mutex);
+        last_info = {0, 0, {}, 0, 0, {}};
+    }
+
+    // Everything is copied, the caller's position and config may be gone before the search is
+    result = std::async(std::launch::async, [this, pos, side, limits, cfg, on_progress, history = std::move(history)]() {
+        struct search_control control;
+        control.stop = &stop_flag;
+        control.on_progress = [this, &on_progress](const struct search_info& info) {
+            {
+                std::lock_guard<std::mutex> lock(info_mutex);
+                last_info = info;
+            }
+            if(on_progress)
+                on_progress(info);
+        };
+        struct search_info final_info;
+        const struct engine_eval eval = think(pos, side, limits, cfg, &final_info, &control, &history);
+        {
+            std::lock_guard<std::mutex> lock(info_mutex);
+            last_info = final_info;
+        }
+        busy = false;
+        return eval;
+    }).share();
+    return result;
+}
+
+void NerdChess::engine::searcher::stop() {
+    stop_flag = true;
+}
+
+bool NerdChess::engine::searcher::running() const {
+    return busy;
+}
+
+struct NerdChess::engine::engine_eval NerdChess::engine::searcher::wait() {
+    if(!result.valid())
+        return {0, {-1, -1}, NO_MOVE};
+    return result.get();
+}
+
+struct NerdChess::engine::search_info NerdChess::engine::searcher::info() {
+    std::lock_guard<std::mutex> lock(info_mutex);
+    return last_info;
+}
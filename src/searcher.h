@@ -0,0 +1,47 @@
+#ifndef SEARCHER_H
+#define SEARCHER_H
+
+#include <iostream>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include "engine.h"
+
+namespace NerdChess {
+namespace engine {
+// Runs think() on its own thread, so that a front-end stays responsive while the engine thinks:
+//
+//     engine::searcher s;
+//     std::shared_future<engine::engine_eval> result = s.start(pos, side, limits, cfg, on_progress);
+//     ...
+//     s.stop(); // Optional, the search then returns its best move so far
+//     engine::engine_eval eval = result.get();
+//
+// on_progress is called from the search thread after every completed depth.
+struct searcher {
+    searcher();
+    ~searcher(); // Stops the running search and waits for it
+    searcher(const searcher&) = delete;
+    searcher& operator=(const searcher&) = delete;
+
+    // Stops and waits for a search which is still running, then starts a new one. history holds the hashes of
+    // the game positions before pos, see think().
+    std::shared_future<struct engine_eval> start(const struct board::position& pos, bool side, const struct search_limits& limits,
+                                                 const struct config& cfg, std::function<void(const struct search_info&)> on_progress = nullptr,
+                                                 std::vector<uint64_t> history = {});
+    void stop();
+    bool running() const;
+    struct engine_eval wait(); // Blocks until the search is done and returns its result
+    struct search_info info(); // Progress of the last completed depth
+
+private:
+    std::atomic<bool> stop_flag;
+    std::atomic<bool> busy;
+    std::shared_future<struct engine_eval> result;
+    std::mutex info_mutex;
+    struct search_info last_info;
+};
+} // namespace engine
+} // namespace NerdChess
+
+#endif
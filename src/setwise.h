@@ -0,0 +1,193 @@
+#ifndef SETWISE_H
+#define SETWISE_H
+
+#include <iostream>
+#include <cstdint>
+#include "bitboard.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Squares of the a- and h-file (square 0 is a8, so the file is the index modulo 8)
+#define FILE_A 0x0101010101010101ULL
+#define FILE_H 0x8080808080808080ULL
+#define NOT_FILE_A (~FILE_A)
+#define NOT_FILE_H (~FILE_H)
+
+#define SETWISE_LANES 4 // Bitboards in a pack
+
+namespace NerdChess {
+namespace setwise {
+// Attacks of whole sets of pieces at once: each function takes every piece of one kind as a single bitboard
+// and returns the union of their attacks, without looping over the pieces. Sliders use Kogge-Stone
+// (occluded) fills, with AVX2 four directions are filled at the same time. Like the control maps, a
+// blocked ray includes the blocking square, whichever color is on it.
+//
+// The functions are templates so that with AVX2 they also work on packs: the same bitboard of SETWISE_LANES
+// different positions side by side in one register, which are then all filled at once.
+
+#if defined(__AVX2__)
+// One bitboard of each of SETWISE_LANES positions. Besides the bit operations a pack also holds a signed
+// 64 bit number per position, such as the counts of popcount, which can be added and multiplied.
+struct pack {
+	__m256i v;
+	pack() : v(_mm256_setzero_si256()) {}
+	explicit pack(__m256i v) : v(v) {}
+	explicit pack(uint64_t a, uint64_t b, uint64_t c, uint64_t d);
+	int64_t operator[](int lane) const;
+};
+
+inline pack::pack(uint64_t a, uint64_t b, uint64_t c, uint64_t d) : v(_mm256_set_epi64x(d, c, b, a)) {}
+inline int64_t pack::operator[](int lane) const {
+	alignas(32) int64_t lanes[SETWISE_LANES];
+	_mm256_store_si256((__m256i*)lanes, v);
+	return lanes[lane];
+}
+inline pack operator&(pack a, pack b) { return pack(_mm256_and_si256(a.v, b.v)); }
+inline pack operator|(pack a, pack b) { return pack(_mm256_or_si256(a.v, b.v)); }
+inline pack operator~(pack a) { return pack(_mm256_xor_si256(a.v, _mm256_set1_epi64x(-1))); }
+inline pack operator&(pack a, bitb::bitboard mask) { return pack(_mm256_and_si256(a.v, _mm256_set1_epi64x(mask))); }
+inline pack operator<<(pack a, int s) { return pack(_mm256_sll_epi64(a.v, _mm_cvtsi32_si128(s))); }
+inline pack operator>>(pack a, int s) { return pack(_mm256_srl_epi64(a.v, _mm_cvtsi32_si128(s))); }
+inline pack operator+(pack a, pack b) { return pack(_mm256_add_epi64(a.v, b.v)); }
+inline pack operator-(pack a, pack b) { return pack(_mm256_sub_epi64(a.v, b.v)); }
+// Only for numbers which fit in 32 bits
+inline pack operator*(pack a, int b) { return pack(_mm256_mul_epi32(a.v, _mm256_set1_epi64x(b))); }
+
+// Bits set in each lane: every nibble looked up in a 16 entry table, then the bytes added up
+inline pack popcount(pack a) {
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low = _mm256_set1_epi8(0x0f);
+	const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(a.v, low)),
+										   _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi64(a.v, 4), low)));
+	return pack(_mm256_sad_epu8(counts, _mm256_setzero_si256()));
+}
+inline pack& operator|=(pack& a, pack b) { return a = a | b; }
+inline pack& operator&=(pack& a, pack b) { return a = a & b; }
+inline pack& operator+=(pack& a, pack b) { return a = a + b; }
+#endif
+
+// Directions as shifts: positive to the higher squares (towards h1), negative to the lower ones. The
+// mask removes what wrapped around to the other edge of the board.
+template<typename B>
+inline B shift(B bb, int s, bitb::bitboard mask) {
+	return (s > 0 ? bb << s : bb >> -s) & mask;
+}
+
+// Every square on or north (towards rank 8) / south of a piece, and the whole files of the pieces
+template<typename B>
+inline B north_fill(B bb) {
+	bb |= bb >> 8;
+	bb |= bb >> 16;
+	return bb | (bb >> 32);
+}
+
+template<typename B>
+inline B south_fill(B bb) {
+	bb |= bb << 8;
+	bb |= bb << 16;
+	return bb | (bb << 32);
+}
+
+template<typename B>
+inline B file_fill(B bb) {
+	return north_fill(bb) | south_fill(bb);
+}
+
+// The squares on both sides (same rank)
+template<typename B>
+inline B sides(B bb) {
+	return ((bb << 1) & NOT_FILE_A) | ((bb >> 1) & NOT_FILE_H);
+}
+
+// Us is the color of the pawns (white pawns move to the lower squares)
+template<bool Us, typename B>
+inline B pawn_attacks(B pawns) {
+	if(!Us)
+		return ((pawns >> 9) & NOT_FILE_H) | ((pawns >> 7) & NOT_FILE_A);
+	return ((pawns << 7) & NOT_FILE_H) | ((pawns << 9) & NOT_FILE_A);
+}
+
+template<typename B>
+inline B knight_attacks(B knights) {
+	const B l1 = (knights >> 1) & 0x7f7f7f7f7f7f7f7fULL;
+	const B l2 = (knights >> 2) & 0x3f3f3f3f3f3f3f3fULL;
+	const B r1 = (knights << 1) & 0xfefefefefefefefeULL;
+	const B r2 = (knights << 2) & 0xfcfcfcfcfcfcfcfcULL;
+	const B h1 = l1 | r1;
+	const B h2 = l2 | r2;
+	return (h1 << 16) | (h1 >> 16) | (h2 << 8) | (h2 >> 8);
+}
+
+template<typename B>
+inline B king_attacks(B kings) {
+	const B row = ((kings << 1) & NOT_FILE_A) | ((kings >> 1) & NOT_FILE_H);
+	return row | ((row | kings) << 8) | ((row | kings) >> 8);
+}
+
+// Squares reached from the pieces in one direction, up to and including the first occupied square
+template<typename B>
+inline B fill(B pieces, B empty, int s, bitb::bitboard mask) {
+	empty = empty & mask;
+	pieces |= empty & shift(pieces, s, ~0ULL);
+	empty &= shift(empty, s, ~0ULL);
+	pieces |= empty & shift(pieces, 2 * s, ~0ULL);
+	empty &= shift(empty, 2 * s, ~0ULL);
+	pieces |= empty & shift(pieces, 4 * s, ~0ULL);
+	return shift(pieces, s, mask);
+}
+
+// Union of the attacks of the diagonal (bishops and queens) and straight (rooks and queens) sliders
+inline bitb::bitboard slider_attacks(bitb::bitboard diagonal, bitb::bitboard straight, bitb::bitboard occupied) {
+	const bitb::bitboard empty = ~occupied;
+#if defined(__AVX2__)
+	// East, south, south-east and south-west in one register, west, north, north-west and north-east in the other
+	const __m256i shifts = _mm256_set_epi64x(7, 9, 8, 1);
+	const __m256i masks_up = _mm256_set_epi64x(NOT_FILE_H, NOT_FILE_A, ~0ULL, NOT_FILE_A);
+	const __m256i masks_down = _mm256_set_epi64x(NOT_FILE_A, NOT_FILE_H, ~0ULL, NOT_FILE_H);
+	__m256i gen_up = _mm256_set_epi64x(diagonal, diagonal, straight, straight);
+	__m256i gen_down = gen_up;
+	__m256i pro_up = _mm256_and_si256(_mm256_set1_epi64x(empty), masks_up);
+	__m256i pro_down = _mm256_and_si256(_mm256_set1_epi64x(empty), masks_down);
+	__m256i s = shifts;
+	for(int i = 0; i < 3; ++i) {
+		gen_up = _mm256_or_si256(gen_up, _mm256_and_si256(pro_up, _mm256_sllv_epi64(gen_up, s)));
+		pro_up = _mm256_and_si256(pro_up, _mm256_sllv_epi64(pro_up, s));
+		gen_down = _mm256_or_si256(gen_down, _mm256_and_si256(pro_down, _mm256_srlv_epi64(gen_down, s)));
+		pro_down = _mm256_and_si256(pro_down, _mm256_srlv_epi64(pro_down, s));
+		s = _mm256_add_epi64(s, s);
+	}
+	const __m256i attacks = _mm256_or_si256(_mm256_and_si256(_mm256_sllv_epi64(gen_up, shifts), masks_up),
+											_mm256_and_si256(_mm256_srlv_epi64(gen_down, shifts), masks_down));
+	const __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+	return (bitb::bitboard)(_mm_cvtsi128_si64(half) | _mm_extract_epi64(half, 1));
+#else
+	return fill(straight, empty, 1, NOT_FILE_A) | fill(straight, empty, -1, NOT_FILE_H)
+		| fill(straight, empty, 8, ~0ULL) | fill(straight, empty, -8, ~0ULL)
+		| fill(diagonal, empty, 9, NOT_FILE_A) | fill(diagonal, empty, 7, NOT_FILE_H)
+		| fill(diagonal, empty, -7, NOT_FILE_A) | fill(diagonal, empty, -9, NOT_FILE_H);
+#endif
+}
+
+#if defined(__AVX2__)
+// Packs of positions are filled one direction after the other, with every position in its own lane
+inline pack slider_attacks(pack diagonal, pack straight, pack occupied) {
+	const pack empty = ~occupied;
+	return fill(straight, empty, 1, NOT_FILE_A) | fill(straight, empty, -1, NOT_FILE_H)
+		| fill(straight, empty, 8, ~0ULL) | fill(straight, empty, -8, ~0ULL)
+		| fill(diagonal, empty, 9, NOT_FILE_A) | fill(diagonal, empty, 7, NOT_FILE_H)
+		| fill(diagonal, empty, -7, NOT_FILE_A) | fill(diagonal, empty, -9, NOT_FILE_H);
+}
+#endif
+
+inline bitb::bitboard bishop_attacks(bitb::bitboard bishops, bitb::bitboard occupied) {
+	return slider_attacks(bishops, 0ULL, occupied);
+}
+
+inline bitb::bitboard rook_attacks(bitb::bitboard rooks, bitb::bitboard occupied) {
+	return slider_attacks(0ULL, rooks, occupied);
+}
+} // namespace setwise
+} // namespace NerdChess
+
+#endif
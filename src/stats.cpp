@@ -0,0 +1,114 @@
+#include <iostream>
+#include <sstream>
+#include <mutex>
+#include <cstring>
+#include <math.h>
+#include "stats.h"
+
+thread_local struct NerdChess::engine::stats::search_stats NerdChess::engine::stats::local = {};
+
+static struct NerdChess::engine::stats::search_stats totals = {};
+static std::mutex totals_mutex;
+
+void NerdChess::engine::stats::reset() {
+    std::memset(&local, 0, sizeof(local));
+}
+
+void NerdChess::engine::stats::merge() {
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    add(totals, local);
+    std::memset(&local, 0, sizeof(local));
+}
+
+void NerdChess::engine::stats::clear() {
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    std::memset(&totals, 0, sizeof(totals));
+}
+
+struct NerdChess::engine::stats::search_stats NerdChess::engine::stats::get() {
+    std::lock_guard<std::mutex> lock(totals_mutex);
+    return totals;
+}
+
+void NerdChess::engine::stats::add(struct search_stats& to, const struct search_stats& from) {
+    to.nodes += from.nodes;
+    to.leaf_nodes += from.leaf_nodes;
+    to.interior_nodes += from.interior_nodes;
+    to.moves_searched += from.moves_searched;
+    to.cutoffs += from.cutoffs;
+    to.first_move_cutoffs += from.first_move_cutoffs;
+    to.hash_probes += from.hash_probes;
+    to.hash_hits += from.hash_hits;
+    to.movegen_calls += from.movegen_calls;
+    to.movegen_ticks += from.movegen_ticks;
+    to.eval_calls += from.eval_calls;
+    to.eval_ticks += from.eval_ticks;
+    to.quiescence_nodes += from.quiescence_nodes;
+    to.see_pruned += from.see_pruned;
+    to.futility_pruned += from.futility_pruned;
+    to.reverse_futility_cutoffs += from.reverse_futility_cutoffs;
+    to.razor_cutoffs += from.razor_cutoffs;
+    for(int i = 0; i < STATS_MAX_DEPTH; ++i)
+        to.nodes_by_depth[i] += from.nodes_by_depth[i];
+}
+
+double NerdChess::engine::stats::cutoff_rate(const struct search_stats& s) {
+    return s.interior_nodes ? (double)s.cutoffs / s.interior_nodes : 0.0;
+}
+
+double NerdChess::engine::stats::first_move_cutoff_rate(const struct search_stats& s) {
+    return s.cutoffs ? (double)s.first_move_cutoffs / s.cutoffs : 0.0;
+}
+
+double NerdChess::engine::stats::hash_hit_rate(const struct search_stats& s) {
+    return s.hash_probes ? (double)s.hash_hits / s.hash_probes : 0.0;
+}
+
+// Nodes of the deepest iteration raised to 1/depth (the usual N^(1/d) definition)
+double NerdChess::engine::stats::effective_branching_factor(const struct search_stats& s) {
+    int depth = 0;
+    for(int i = STATS_MAX_DEPTH - 1; i > 0; --i) {
+        if(s.nodes_by_depth[i]) {
+            depth = i;
+            break;
+        }
+    }
+    if(depth == 0)
+        return 0.0;
+    return pow((double)s.nodes, 1.0 / depth);
+}
+
+std::string NerdChess::engine::stats::to_json(const struct search_stats& s) {
+    std::ostringstream json;
+    json << "{";
+    json << "\"nodes\": " << s.nodes;
+    json << ", \"leaf_nodes\": " << s.leaf_nodes;
+    json << ", \"interior_nodes\": " << s.interior_nodes;
+    json << ", \"moves_searched\": " << s.moves_searched;
+    json << ", \"cutoffs\": " << s.cutoffs;
+    json << ", \"first_move_cutoffs\": " << s.first_move_cutoffs;
+    json << ", \"cutoff_rate\": " << cutoff_rate(s);
+    json << ", \"first_move_cutoff_rate\": " << first_move_cutoff_rate(s);
+    json << ", \"effective_branching_factor\": " << effective_branching_factor(s);
+    json << ", \"hash_probes\": " << s.hash_probes;
+    json << ", \"hash_hits\": " << s.hash_hits;
+    json << ", \"hash_hit_rate\": " << hash_hit_rate(s);
+    json << ", \"movegen_calls\": " << s.movegen_calls;
+    json << ", \"movegen_ticks\": " << s.movegen_ticks;
+    json << ", \"eval_calls\": " << s.eval_calls;
+    json << ", \"eval_ticks\": " << s.eval_ticks;
+    json << ", \"quiescence_nodes\": " << s.quiescence_nodes;
+    json << ", \"see_pruned\": " << s.see_pruned;
+    json << ", \"futility_pruned\": " << s.futility_pruned;
+    json << ", \"reverse_futility_cutoffs\": " << s.reverse_futility_cutoffs;
+    json << ", \"razor_cutoffs\": " << s.razor_cutoffs;
+    json << ", \"nodes_by_depth\": [";
+    int last = 0;
+    for(int i = 0; i < STATS_MAX_DEPTH; ++i)
+        if(s.nodes_by_depth[i])
+            last = i;
+    for(int i = 0; i <= last; ++i)
+        json << (i ? ", " : "") << s.nodes_by_depth[i];
+    json << "]}";
+    return json.str();
+}
@@ -0,0 +1,83 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+#define STATS_MAX_DEPTH 64
+
+namespace NerdChess {
+namespace engine {
+namespace stats {
+// Counters collected by the search. Every thread counts into its own copy (see local),
+// which gets added to the global totals with merge() once the search is done.
+struct search_stats {
+    uint64_t nodes; // Every call to minimax
+    uint64_t leaf_nodes; // Nodes which were evaluated statically (depth 0)
+    uint64_t interior_nodes; // Nodes which searched at least one move
+    uint64_t moves_searched; // Moves tried in interior nodes
+    uint64_t cutoffs; // Beta (or alpha) cutoffs
+    uint64_t first_move_cutoffs; // Cutoffs caused by the first move tried
+    uint64_t hash_probes; // Hash table lookups
+    uint64_t hash_hits; // Hash table lookups which found the position
+    uint64_t movegen_calls;
+    uint64_t movegen_ticks; // Time spent generating moves
+    uint64_t eval_calls;
+    uint64_t eval_ticks; // Time spent in eval::eval_position
+    uint64_t quiescence_nodes; // Nodes of the quiescence search (not part of nodes)
+    uint64_t see_pruned; // Captures the quiescence search skipped because they lose material
+    uint64_t futility_pruned; // Quiet moves skipped near the leaves
+    uint64_t reverse_futility_cutoffs;
+    uint64_t razor_cutoffs;
+    uint64_t nodes_by_depth[STATS_MAX_DEPTH]; // Nodes indexed by the remaining depth
+};
+
+extern thread_local struct search_stats local;
+
+// Cheap timestamp for the movegen/eval timers (TSC cycles on x86, nanoseconds elsewhere)
+inline uint64_t ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void reset(); // Clears the counters of the calling thread
+void merge(); // Adds the counters of the calling thread to the totals and clears them
+void clear(); // Clears the totals
+struct search_stats get(); // Returns the totals
+void add(struct search_stats& to, const struct search_stats& from);
+double cutoff_rate(const struct search_stats& s);
+double first_move_cutoff_rate(const struct search_stats& s);
+double hash_hit_rate(const struct search_stats& s);
+double effective_branching_factor(const struct search_stats& s);
+std::string to_json(const struct search_stats& s);
+} // namespace stats
+} // namespace engine
+} // namespace NerdChess
+
+// The search only touches the counters through these macros so that they compile to nothing
+// unless NERDCHESS_STATS is defined (make STATS=1).
+#ifdef NERDCHESS_STATS
+#define STATS_INC(field) (++NerdChess::engine::stats::local.field)
+#define STATS_ADD(field, n) (NerdChess::engine::stats::local.field += (n))
+#define STATS_TIMER_START(name) const uint64_t name = NerdChess::engine::stats::ticks()
+#define STATS_TIMER_STOP(name, field) (NerdChess::engine::stats::local.field += NerdChess::engine::stats::ticks() - (name))
+#else
+#define STATS_INC(field) ((void)0)
+#define STATS_ADD(field, n) ((void)0)
+#define STATS_TIMER_START(name) ((void)0)
+#define STATS_TIMER_STOP(name, field) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include "trace.h"
+
+thread_local NerdChess::movegen::move NerdChess::engine::trace::line[MAX_PLY] = {};
+
+static std::ofstream file;
+static std::mutex file_mutex;
+static std::atomic<bool> active(false);
+static std::atomic<uint32_t> session(0); // Counts open(), buffers left over from an older file are dropped
+static std::atomic<uint32_t> thread_count(0);
+static uint32_t sample_rate = TRACE_DEFAULT_SAMPLE;
+static int full_plies = TRACE_DEFAULT_FULL_PLIES;
+
+// Records from head - pending up to head are not written yet, head only grows (the index wraps around)
+struct ring {
+    std::vector<struct NerdChess::engine::trace::record> records;
+    uint64_t head = 0;
+    uint64_t pending = 0;
+    uint32_t session = 0;
+    uint32_t sampled = 0; // Deep nodes seen since the last sampled one
+    int thread = -1;
+};
+
+static thread_local struct ring buffer;
+
+static void write_pending(struct ring& b) {
+    if(b.pending == 0)
+        return;
+    // Both parts of a wrapped around range
+    const uint64_t first = (b.head - b.pending) & (TRACE_BUFFER_RECORDS - 1);
+    const uint64_t count = std::min<uint64_t>(b.pending, TRACE_BUFFER_RECORDS - first);
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if(b.session == session.load() && file.is_open()) {
+        file.write((const char*)&b.records[first], count * sizeof(struct NerdChess::engine::trace::record));
+        file.write((const char*)&b.records[0], (b.pending - count) * sizeof(struct NerdChess::engine::trace::record));
+    }
+    b.pending = 0;
+}
+
+bool NerdChess::engine::trace::open(const std::string& path, int rate, int plies) {
+#ifndef NERDCHESS_TRACE
+    (void)path;
+    (void)rate;
+    (void)plies;
+    std::cerr << "Tracing is not compiled in, build with make TRACE=1\n";
+    return false;
+#else
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if(file.is_open())
+        file.close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+        return false;
+    sample_rate = std::max(1, rate);
+    full_plies = std::max(0, plies);
+    struct file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "NCTRACE1", 8);
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(struct record);
+    header.sample_rate = sample_rate;
+    header.full_plies = full_plies;
+    file.write((const char*)&header, sizeof(header));
+    session++;
+    active = true;
+    return (bool)file;
+#endif
+}
+
+void NerdChess::engine::trace::flush() {
+    write_pending(buffer);
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if(file.is_open())
+        file.flush();
+}
+
+void NerdChess::engine::trace::close() {
+    flush();
+    std::lock_guard<std::mutex> lock(file_mutex);
+    active = false;
+    file.close();
+}
+
+bool NerdChess::engine::trace::enabled() {
+    return active.load(std::memory_order_relaxed);
+}
+
+bool NerdChess::engine::trace::sample(int ply) {
+    if(ply < full_plies)
+        return true;
+    if(++buffer.sampled < sample_rate)
+        return false;
+    buffer.sampled = 0;
+    return true;
+}
+
+void NerdChess::engine::trace::write(const struct record& r) {
+    struct ring& b = buffer;
+    if(b.session != session.load(std::memory_order_relaxed)) {
+        if(b.records.empty())
+            b.records.resize(TRACE_BUFFER_RECORDS);
+        if(b.thread < 0)
+            b.thread = thread_count++;
+        b.session = session;
+        b.head = 0;
+        b.pending = 0;
+    }
+    b.records[b.head & (TRACE_BUFFER_RECORDS - 1)] = r;
+    b.records[b.head & (TRACE_BUFFER_RECORDS - 1)].thread = b.thread;
+    b.head++;
+    if(++b.pending == TRACE_BUFFER_RECORDS)
+        write_pending(b);
+}
+
+NerdChess::engine::trace::scope::scope(const uint64_t& nodes, int ply, int depth, int alpha, int beta, const int& score)
+    : active(enabled() && sample(ply)), nodes(nodes), start(nodes), score(score) {
+    if(!active)
+        return;
+    r.move = ply > 0 && ply <= MAX_PLY ? line[ply - 1] : NO_MOVE;
+    r.root_move = ply > 0 ? line[0] : NO_MOVE;
+    r.ply = std::min(ply, 255);
+    r.depth = std::min(depth, 255);
+    r.thread = 0;
+    r.alpha = alpha;
+    r.beta = beta;
+}
+
+NerdChess::engine::trace::scope::~scope() {
+    if(!active)
+        return;
+    r.reason = reason;
+    r.score = score;
+    r.nodes = (uint32_t)std::min<uint64_t>(nodes - start, UINT32_MAX);
+    write(r);
+}
@@ -0,0 +1,104 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include "movegen.h"
+#include "movepick.h"
+
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_RECORDS 4096 // Per thread, a power of two
+#define TRACE_DEFAULT_SAMPLE 64
+#define TRACE_DEFAULT_FULL_PLIES 2 // The root and its children are always recorded
+
+// Why a node returned (record::reason)
+#define TRACE_SEARCHED 0 // Every move was searched
+#define TRACE_CUTOFF 1 // A move reached beta (alpha for black)
+#define TRACE_HASH 2 // Hash table cutoff
+#define TRACE_MATE 3 // Game over, or no legal moves
+#define TRACE_DRAW 4 // Repetition or fifty-move rule
+#define TRACE_LEAF 5 // Depth 0, the quiescence search took over
+#define TRACE_BITBASE 6
+#define TRACE_REVERSE_FUTILITY 7
+#define TRACE_RAZOR 8
+#define TRACE_STOPPED 9 // Out of time or stopped
+#define TRACE_REASONS 10
+
+namespace NerdChess {
+namespace engine {
+namespace trace {
+// Search tracer for finding out where the nodes of a search went. Every traced node of search() leaves one
+// fixed-size record, written when the node returns so that the size of its subtree is known. Each thread
+// collects its records in its own ring buffer, which is appended to the trace file whenever it wraps around
+// and at the end of every think(). The root and its children (full_plies) are always recorded, deeper nodes
+// one in sample_rate. See tools/trace.cpp for the summary.
+//
+// Only compiled in with NERDCHESS_TRACE (make TRACE=1), otherwise open() fails and the search is untouched.
+struct record {
+    movegen::move move; // Move which led to the node, NO_MOVE at the root
+    movegen::move root_move; // Root move this node is below
+    uint8_t ply;
+    uint8_t depth; // Remaining depth
+    uint8_t reason; // TRACE_*
+    uint8_t thread; // Threads are numbered in the order they first recorded something
+    int32_t alpha;
+    int32_t beta;
+    int32_t score;
+    uint32_t nodes; // Nodes of the subtree, quiescence nodes included (saturates)
+};
+
+static_assert(sizeof(struct record) == 24, "trace record must be 24 bytes");
+
+// Start of a trace file, followed by the records
+struct file_header {
+    char magic[8]; // "NCTRACE1"
+    uint32_t version; // TRACE_VERSION
+    uint32_t record_size; // sizeof(struct record)
+    uint32_t sample_rate;
+    uint32_t full_plies;
+};
+
+bool open(const std::string& path, int sample_rate = TRACE_DEFAULT_SAMPLE, int full_plies = TRACE_DEFAULT_FULL_PLIES);
+void flush(); // Writes out the records of the calling thread
+void close(); // Flushes the calling thread and closes the file, the other threads must have flushed already
+bool enabled();
+
+// Moves of the current line of the calling thread, line[ply] leads to the node at ply + 1
+extern thread_local movegen::move line[MAX_PLY];
+
+bool sample(int ply);
+void write(const struct record& r);
+
+// Records a node when it goes out of scope. score points to the result of the node, which is only known then.
+struct scope {
+    scope(const uint64_t& nodes, int ply, int depth, int alpha, int beta, const int& score);
+    ~scope();
+    uint8_t reason = TRACE_SEARCHED;
+
+private:
+    bool active;
+    const uint64_t& nodes;
+    uint64_t start;
+    const int& score;
+    struct record r;
+};
+} // namespace trace
+} // namespace engine
+} // namespace NerdChess
+
+// The search only uses the tracer through these macros, which compile to nothing unless NERDCHESS_TRACE is
+// defined (make TRACE=1)
+#ifdef NERDCHESS_TRACE
+#define TRACE_NODE(name, nodes, ply, depth, alpha, beta, score) NerdChess::engine::trace::scope name(nodes, ply, depth, alpha, beta, score)
+#define TRACE_REASON(name, r) ((name).reason = (r))
+#define TRACE_MOVE(ply, m) ((ply) < MAX_PLY ? (void)(NerdChess::engine::trace::line[ply] = (m)) : (void)0)
+#define TRACE_FLUSH() NerdChess::engine::trace::flush()
+#else
+#define TRACE_NODE(name, nodes, ply, depth, alpha, beta, score) ((void)0)
+#define TRACE_REASON(name, r) ((void)0)
+#define TRACE_MOVE(ply, m) ((void)0)
+#define TRACE_FLUSH() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,296 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include "tt.h"
+#include "stats.h"
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+struct NerdChess::engine::tt::hash_table NerdChess::engine::tt::default_table;
+
+NerdChess::engine::tt::hash_table::~hash_table() {
+    release();
+}
+
+void NerdChess::engine::tt::hash_table::release() {
+#if defined(_WIN32)
+    _aligned_free(buckets);
+#else
+    if(mapping) {
+        munmap(mapping, mapping_size);
+        mapping = nullptr;
+    } else {
+        free(buckets);
+    }
+#endif
+    buckets = nullptr;
+    bucket_count = 0;
+}
+
+// With several GB of hash nearly every probe misses the TLB with 4K pages, so on Linux the table is aligned
+// to 2MB and the kernel is asked to back it with transparent huge pages.
+static void* allocate(size_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, 4096);
+#else
+    size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void* mem = aligned_alloc(HUGE_PAGE_SIZE, size);
+#ifdef MADV_HUGEPAGE
+    if(mem)
+        madvise(mem, size, MADV_HUGEPAGE);
+#endif
+    return mem;
+#endif
+}
+
+void NerdChess::engine::tt::hash_table::resize(size_t mb, int threads) {
+    release();
+    if(mb == 0)
+        return;
+
+    // A power of two, so that the bucket can be picked with a mask
+    uint64_t count = 1;
+    while(count * 2 * sizeof(struct bucket) <= (uint64_t)mb * 1024 * 1024)
+        count *= 2;
+    buckets = (struct bucket*)allocate(count * sizeof(struct bucket));
+    if(!buckets) {
+        std::cerr << "Failed to allocate " << mb << " MB for the hash table\n";
+        return;
+    }
+    bucket_count = count;
+    clear(threads);
+}
+
+// Every thread clears a slice, which is also what actually makes the OS map the pages
+void NerdChess::engine::tt::hash_table::clear(int threads) {
+    if(!buckets)
+        return;
+    threads = std::max(1, threads);
+    std::vector<std::thread> pool;
+    for(int i = 0; i < threads; ++i) {
+        pool.emplace_back([this, i, threads]() {
+            const uint64_t start = bucket_count * i / threads;
+            const uint64_t end = bucket_count * (i + 1) / threads;
+            memset((void*)&buckets[start], 0, (end - start) * sizeof(struct bucket));
+        });
+    }
+    for(std::thread& thread : pool)
+        thread.join();
+    generation = 0;
+}
+
+void NerdChess::engine::tt::hash_table::new_search() {
+    generation += 4;
+}
+
+const struct NerdChess::engine::tt::entry* NerdChess::engine::tt::hash_table::probe(uint64_t key) {
+    if(!buckets)
+        return nullptr;
+    STATS_INC(hash_probes);
+    struct bucket& b = buckets[key & (bucket_count - 1)];
+    const uint16_t key16 = key >> 48;
+    for(int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        struct entry& e = b.entries[i];
+        if(e.key == key16 && (e.gen_bound & 3) != TT_NONE) {
+            e.gen_bound = generation | (e.gen_bound & 3); // Still in use, don't let it age
+            STATS_INC(hash_hits);
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+const struct NerdChess::engine::tt::entry* NerdChess::engine::tt::hash_table::peek(uint64_t key) const {
+    if(!buckets)
+        return nullptr;
+    const struct bucket& b = buckets[key & (bucket_count - 1)];
+    const uint16_t key16 = key >> 48;
+    for(int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        if(b.entries[i].key == key16 && (b.entries[i].gen_bound & 3) != TT_NONE)
+            return &b.entries[i];
+    }
+    return nullptr;
+}
+
+void NerdChess::engine::tt::hash_table::store(uint64_t key, movegen::move move, int score, int depth, int bound) {
+    if(!buckets)
+        return;
+    struct bucket& b = buckets[key & (bucket_count - 1)];
+    const uint16_t key16 = key >> 48;
+
+    // Overwrite the same position if there is one, otherwise the entry worth the least:
+    // shallow entries from old searches go first
+    struct entry* replace = &b.entries[0];
+    int worst = INT_MAX;
+    for(int i = 0; i < TT_BUCKET_SIZE; ++i) {
+        struct entry& e = b.entries[i];
+        if(e.key == key16 || (e.gen_bound & 3) == TT_NONE) {
+            replace = &e;
+            break;
+        }
+        const int age = (uint8_t)(generation - (e.gen_bound & 0xfc));
+        const int value = e.depth - age * 2;
+        if(value < worst) {
+            worst = value;
+            replace = &e;
+        }
+    }
+
+    // Don't throw away a deeper result of the same position from this search
+    if(replace->key == key16 && (replace->gen_bound & 3) != TT_NONE && bound != TT_EXACT && depth + 2 < replace->depth && (replace->gen_bound & 0xfc) == generation)
+        return;
+
+    if(move != NO_MOVE || replace->key != key16)
+        replace->move = move;
+    replace->key = key16;
+    replace->score = (int16_t)std::max(-INT16_MAX, std::min(INT16_MAX, score));
+    replace->depth = (uint8_t)depth;
+    replace->gen_bound = generation | bound;
+}
+
+int NerdChess::engine::tt::hash_table::hashfull() const {
+    if(!buckets)
+        return 0;
+    int used = 0;
+    const int sampled = (int)std::min<uint64_t>(1000 / TT_BUCKET_SIZE, bucket_count);
+    for(int i = 0; i < sampled; ++i)
+        for(int j = 0; j < TT_BUCKET_SIZE; ++j)
+            used += (buckets[i].entries[j].gen_bound & 3) != TT_NONE && (buckets[i].entries[j].gen_bound & 0xfc) == generation;
+    return used * 1000 / (sampled * TT_BUCKET_SIZE);
+}
+
+// splitmix64 finalizer of every 64-bit word mixed with its index, summed up so that slices can be done in parallel
+static uint64_t checksum(const struct NerdChess::engine::tt::bucket* buckets, uint64_t count, int threads) {
+    threads = std::max(1, threads);
+    std::vector<uint64_t> sums(threads, 0);
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            const uint64_t* words = (const uint64_t*)buckets;
+            const uint64_t start = count * t / threads * TT_BUCKET_SIZE, end = count * (t + 1) / threads * TT_BUCKET_SIZE;
+            uint64_t sum = 0;
+            for(uint64_t i = start; i < end; ++i) {
+                uint64_t x = words[i] + i * 0x9e3779b97f4a7c15ULL;
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                sum += x ^ (x >> 31);
+            }
+            sums[t] = sum;
+        });
+    }
+    for(std::thread& thread : pool)
+        thread.join();
+    uint64_t total = 0;
+    for(uint64_t sum : sums)
+        total += sum;
+    return total;
+}
+
+static uint64_t header_checksum(const struct NerdChess::engine::tt::snapshot_header& header) {
+    uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+    const uint8_t* bytes = (const uint8_t*)&header;
+    for(size_t i = 0; i < offsetof(struct NerdChess::engine::tt::snapshot_header, header_checksum); ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t key_check() {
+    struct NerdChess::board::position pos;
+    NerdChess::board::setup_position(pos);
+    return NerdChess::board::compute_key(pos);
+}
+
+bool NerdChess::engine::tt::hash_table::save(const std::string& path, int threads) const {
+    if(!buckets)
+        return false;
+    struct snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "NCTTSNAP", 8);
+    header.version = TT_SNAPSHOT_VERSION;
+    header.bucket_size = sizeof(struct bucket);
+    header.bucket_count = bucket_count;
+    header.key_check = key_check();
+    header.table_checksum = checksum(buckets, bucket_count, threads);
+    header.generation = generation;
+    header.header_checksum = header_checksum(header);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    std::vector<char> page(TT_SNAPSHOT_HEADER_SIZE, 0);
+    memcpy(page.data(), &header, sizeof(header));
+    file.write(page.data(), page.size());
+    file.write((const char*)buckets, bucket_count * sizeof(struct bucket));
+    return (bool)file;
+}
+
+bool NerdChess::engine::tt::hash_table::load(const std::string& path, int threads, bool verify) {
+    struct snapshot_header header;
+    std::ifstream file(path, std::ios::binary);
+    if(!file.read((char*)&header, sizeof(header))) {
+        std::cerr << "Could not read the hash snapshot " << path << "\n";
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    const uint64_t file_size = file.tellg();
+    if(memcmp(header.magic, "NCTTSNAP", 8) != 0 || header.header_checksum != header_checksum(header) || header.version != TT_SNAPSHOT_VERSION
+        || header.bucket_size != sizeof(struct bucket) || header.key_check != key_check() || header.bucket_count == 0
+        || (header.bucket_count & (header.bucket_count - 1)) != 0 || file_size != TT_SNAPSHOT_HEADER_SIZE + header.bucket_count * sizeof(struct bucket)) {
+        std::cerr << "Invalid or incompatible hash snapshot " << path << "\n";
+        return false;
+    }
+
+    struct bucket* loaded = nullptr;
+#if defined(_WIN32)
+    const size_t table_size = header.bucket_count * sizeof(struct bucket);
+    loaded = (struct bucket*)allocate(table_size);
+    if(!loaded || !file.seekg(TT_SNAPSHOT_HEADER_SIZE).read((char*)loaded, table_size)) {
+        _aligned_free(loaded);
+        return false;
+    }
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    void* mem = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping stays valid
+    if(mem == MAP_FAILED) {
+        std::cerr << "Could not map the hash snapshot " << path << "\n";
+        return false;
+    }
+    loaded = (struct bucket*)((char*)mem + TT_SNAPSHOT_HEADER_SIZE);
+#endif
+
+    if(verify && checksum(loaded, header.bucket_count, threads) != header.table_checksum) {
+        std::cerr << "Checksum mismatch in the hash snapshot " << path << "\n";
+#if defined(_WIN32)
+        _aligned_free(loaded);
+#else
+        munmap(mem, file_size);
+#endif
+        return false;
+    }
+
+    release();
+    buckets = loaded;
+    bucket_count = header.bucket_count;
+#if !defined(_WIN32)
+    mapping = mem;
+    mapping_size = file_size;
+#endif
+    // After the new_search of the next search the loaded entries count as one search old, so they are the
+    // first to be replaced if they aren't used
+    generation = header.generation;
+    return true;
+}
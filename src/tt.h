@@ -0,0 +1,110 @@
+#ifndef TT_H
+#define TT_H
+
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include "movegen.h"
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
+
+#define TT_BUCKET_SIZE 8 // Entries per 64 byte bucket
+#define TT_DEFAULT_MB 256
+#define TT_SNAPSHOT_VERSION 1
+#define TT_SNAPSHOT_HEADER_SIZE 4096 // The table starts on its own page, so it can be used straight from the mapping
+
+// Bounds of a stored score
+#define TT_NONE 0
+#define TT_UPPER 1 // The score is at most this (no move reached alpha)
+#define TT_LOWER 2 // The score is at least this (cutoff)
+#define TT_EXACT 3
+
+namespace NerdChess {
+namespace engine {
+namespace tt {
+// 8 bytes, so that a whole bucket fits in one cache line. Only the upper 16 bits of the key are stored,
+// the lower bits already picked the bucket. A wrong hash move from a collision is caught by is_legal.
+struct entry {
+    uint16_t key;
+    movegen::move move;
+    int16_t score; // Mate scores are stored relative to this position, see search
+    uint8_t depth;
+    uint8_t gen_bound; // Generation in the upper 6 bits, bound in the lower 2
+};
+
+struct alignas(64) bucket {
+    struct entry entries[TT_BUCKET_SIZE];
+};
+
+static_assert(sizeof(struct entry) == 8, "tt entry must be 8 bytes");
+static_assert(sizeof(struct bucket) == 64, "tt bucket must be one cache line");
+
+// Start of a snapshot file (see save), followed by the table
+struct snapshot_header {
+    char magic[8]; // "NCTTSNAP"
+    uint32_t version; // TT_SNAPSHOT_VERSION
+    uint32_t bucket_size; // sizeof(struct bucket)
+    uint64_t bucket_count;
+    uint64_t key_check; // Hash of the start position, so that a snapshot made with other Zobrist keys isn't used
+    uint64_t table_checksum;
+    uint8_t generation;
+    uint8_t padding[7];
+    uint64_t header_checksum; // Of everything above
+};
+
+// One transposition table. A table belongs to one search at a time: the entries are plain memory which
+// nothing synchronizes, and each search ages the whole table (new_search). Engines which search at the same
+// time, like the games of the match runner, each get their own.
+struct hash_table {
+    hash_table() = default;
+    ~hash_table();
+    hash_table(const hash_table&) = delete;
+    hash_table& operator=(const hash_table&) = delete;
+
+    void resize(size_t mb, int threads); // Allocates (with huge pages where possible) and clears the table, 0 frees it
+    void clear(int threads);
+    void new_search(); // Ages all entries, called once per move
+    // Returns the entry of the position, or nullptr. Only the hash move of an entry is guaranteed to be useful at any depth.
+    const struct entry* probe(uint64_t key);
+    const struct entry* peek(uint64_t key) const; // Like probe, but leaves the entry's age alone (for reading lines back)
+    void store(uint64_t key, movegen::move move, int score, int depth, int bound);
+    int hashfull() const; // Permille of the first buckets used by the current search
+
+    // Writes the table with a header to a file, so that a later process can continue with it (see load)
+    bool save(const std::string& path, int threads) const;
+    // Replaces the table (and its size) with a snapshot from save. The file is memory mapped copy-on-write, so the
+    // pages are only read once they are probed; the header is checked right away but the table checksum, which
+    // needs the whole file, only with verify. Entries are checked one at a time when they are used: the key has to
+    // match, the bound must be set and the hash move is tested with is_legal before it is played.
+    bool load(const std::string& path, int threads, bool verify = false);
+
+    inline void prefetch(uint64_t key) const {
+        if(!buckets)
+            return;
+#if defined(__GNUC__)
+        __builtin_prefetch(&buckets[key & (bucket_count - 1)]);
+#elif defined(_MSC_VER)
+        _mm_prefetch((const char*)&buckets[key & (bucket_count - 1)], _MM_HINT_T0);
+#endif
+    }
+
+    struct bucket* buckets = nullptr;
+    uint64_t bucket_count = 0;
+
+private:
+    void release();
+    uint8_t generation = 0; // Steps of 4, the lower 2 bits of gen_bound hold the bound
+    // Set if the table lives in a mapped snapshot file (see load) instead of allocated memory
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+};
+
+// What config::hash points to unless the caller sets up tables of its own
+extern struct hash_table default_table;
+} // namespace tt
+} // namespace engine
+} // namespace NerdChess
+
+#endif
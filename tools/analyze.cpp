@@ -0,0 +1,138 @@
+// Analysis of a single position: prints the best --multipv lines (in SAN, scores from white's point of
+// view) after every completed depth of one iterative-deepening search.
+//
+// The hash table can be saved after the search and loaded again by the next run, which then starts where
+// the last one stopped (see tt::hash_table::save and load). With --trace the search tree is recorded for tools/trace.cpp,
+// one in --sample nodes below the root moves (needs make TRACE=1). --mcts runs the Monte Carlo tree search on
+// --threads threads instead (see mcts.h), which reports whenever its playouts have doubled.
+//
+// The search runs on an engine::searcher. --time doesn't go to the search as a limit, this thread stops it
+// after that long the way a GUI's stop button would, and then reports how long the search took to return its
+// best move so far.
+//
+// Usage: analyze [--fen FEN] [--depth N] [--time MS] [--multipv N] [--hash MB] [--load FILE] [--save FILE] [--verify]
+//                [--trace FILE] [--sample N] [--mcts] [--threads N]
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "../src/engine.h"
+#include "../src/searcher.h"
+#include "../src/pgn.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+using namespace NerdChess;
+
+static std::string score_to_str(int score) {
+    if(std::abs(score) >= MATE_SCORE - MAX_PLY)
+        return score > 0 ? "mate" : "-mate";
+    std::ostringstream str;
+    str << std::showpos << std::fixed << std::setprecision(2) << score / 100.0;
+    return str.str();
+}
+
+static std::string line_to_str(const struct board::position& root, bool side, const std::vector<movegen::move>& pv) {
+    struct board::position pos = root;
+    std::string str;
+    for(movegen::move m : pv) {
+        str += (str.empty() ? "" : " ") + pgn::to_san(pos, side, m);
+        movegen::make_move(pos, m);
+        side = !side;
+    }
+    return str;
+}
+
+int main(int argc, char* argv[]) {
+    std::string fen = START_FEN;
+    struct engine::search_limits limits = {8, 0};
+    struct engine::config cfg = engine::get_default_config();
+    int hash_mb = TT_DEFAULT_MB;
+    std::string load_file, save_file, trace_file;
+    int sample_rate = TRACE_DEFAULT_SAMPLE;
+    bool verify = false;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--verify") {
+            verify = true;
+            continue;
+        }
+        if(arg == "--mcts") {
+            cfg.mode = SEARCH_MCTS;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--fen") fen = value;
+        else if(arg == "--depth") limits.depth = std::max(1, atoi(value.c_str()));
+        else if(arg == "--time") limits.time_ms = std::max(0, atoi(value.c_str()));
+        else if(arg == "--multipv") cfg.multi_pv = std::max(1, atoi(value.c_str()));
+        else if(arg == "--hash") hash_mb = std::max(0, atoi(value.c_str()));
+        else if(arg == "--load") load_file = value;
+        else if(arg == "--save") save_file = value;
+        else if(arg == "--trace") trace_file = value;
+        else if(arg == "--sample") sample_rate = std::max(1, atoi(value.c_str()));
+        else if(arg == "--threads") cfg.threads = std::max(1, atoi(value.c_str()));
+        else {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    generate_board_control_value_map(board_control_value_map_w, WHITE);
+    generate_board_control_value_map(board_control_value_map_b, BLACK);
+    movegen::init();
+    cfg.use_bitbases = false; // Not generated here, see match --bitbases
+    const int threads = std::max(1u, std::thread::hardware_concurrency());
+    if(!load_file.empty()) {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(!engine::tt::default_table.load(load_file, threads, verify))
+            return EXIT_FAILURE;
+        std::cout << "Loaded " << engine::tt::default_table.bucket_count * sizeof(struct engine::tt::bucket) / (1024 * 1024) << " MB of hash in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms\n";
+    } else {
+        engine::tt::default_table.resize(hash_mb, threads);
+    }
+    cfg.use_hash = engine::tt::default_table.buckets != nullptr;
+
+    struct board::position pos;
+    bool side;
+    if(!board::load_fen(pos, fen, side)) {
+        std::cerr << "Invalid FEN " << fen << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if(!trace_file.empty() && !engine::trace::open(trace_file, sample_rate))
+        return EXIT_FAILURE;
+
+    // Called on the search thread, this one only waits in the meantime
+    const auto on_progress = [&pos, side](const struct engine::search_info& info) {
+        std::cout << "depth " << info.depth << ", " << info.nodes << " nodes, " << info.time_ms << " ms\n";
+        for(size_t i = 0; i < info.lines.size(); ++i)
+            std::cout << "  " << i + 1 << ". " << std::setw(6) << score_to_str(info.lines[i].score) << "  " << line_to_str(pos, side, info.lines[i].pv) << "\n";
+    };
+    engine::searcher searcher;
+    const std::shared_future<struct engine::engine_eval> result = searcher.start(pos, side, {limits.depth, 0}, cfg, on_progress);
+    if(limits.time_ms > 0 && result.wait_for(std::chrono::milliseconds(limits.time_ms)) == std::future_status::timeout) {
+        const std::chrono::steady_clock::time_point stopped = std::chrono::steady_clock::now();
+        searcher.stop();
+        result.wait();
+        std::cout << "Stopped, returned after " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stopped).count() << " ms\n";
+    }
+    const struct engine::engine_eval eval = searcher.wait();
+    const struct engine::search_info info = searcher.info();
+    std::cout << "Best move " << (eval.move != NO_MOVE ? pgn::to_san(pos, side, eval.move) : "none") << "\n";
+    std::cout << "Total: " << info.nodes << " nodes, " << info.time_ms << " ms\n";
+    if(!trace_file.empty())
+        engine::trace::close();
+    if(!save_file.empty() && !engine::tt::default_table.save(save_file, threads)) {
+        std::cerr << "Could not save the hash table to " << save_file << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
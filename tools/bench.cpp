@@ -0,0 +1,170 @@
+// Micro-benchmarks for the hot functions of the engine: every function is timed over a fixed set of positions
+// and reported in ns per call, followed by a fixed-depth search of every position. The node count of the
+// searches is printed as the signature, it only changes when the search or the evaluation behaves differently.
+//
+// --mcts searches with the Monte Carlo tree search on --threads threads instead (see mcts.h), where the nodes
+// are playouts and the signature isn't printed since the threads make it vary. --time gives every position
+// a fixed time instead of a depth, so that the two modes can be compared.
+//
+// Usage: bench [--depth N] [--rounds N] [--time MS] [--mcts] [--threads N]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "../src/engine.h"
+
+#define DEFAULT_BENCH_DEPTH 5
+#define DEFAULT_BENCH_ROUNDS 200
+#define BENCH_HASH_MB 16
+
+using namespace NerdChess;
+
+// Openings, middlegames and endgames, with castling, en pessant and promotions among the moves
+static const char* bench_fens[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+    "rnbqkb1r/pp3ppp/4pn2/2pp4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 0 5",
+    "r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 b - - 3 10",
+    "2r3k1/5ppp/p3p3/1p1n4/3P4/P4N2/1P3PPP/2R3K1 w - - 0 25",
+    "8/5pk1/6p1/3P4/8/5KP1/8/8 w - - 0 45",
+    "6k1/5p2/6p1/8/7P/6P1/4rBK1/R7 b - - 0 40",
+};
+
+struct bench_position {
+    struct board::position pos;
+    bool side;
+};
+
+static std::vector<struct bench_position> positions;
+uint64_t sink = 0; // Results are added up here (not static) so that the compiler can't drop the calls
+
+// Calls op(position) rounds times for every position and prints the average time per call
+static void time_op(const std::string& name, int rounds, const std::function<uint64_t(const struct bench_position&)>& op) {
+    uint64_t calls = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int round = 0; round < rounds; ++round) {
+        for(const struct bench_position& p : positions)
+            calls += op(p);
+    }
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::left << std::setw(20) << name << std::right << std::setw(10) << std::fixed << std::setprecision(1)
+              << ns / std::max<uint64_t>(calls, 1) << " ns/op" << std::setw(12) << calls << " calls\n";
+}
+
+int main(int argc, char* argv[]) {
+    int depth = DEFAULT_BENCH_DEPTH, rounds = DEFAULT_BENCH_ROUNDS, time_ms = 0;
+    struct engine::config cfg = engine::get_default_config();
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--mcts") {
+            cfg.mode = SEARCH_MCTS;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--depth") depth = std::max(1, atoi(value.c_str()));
+        else if(arg == "--rounds") rounds = std::max(1, atoi(value.c_str()));
+        else if(arg == "--time") time_ms = std::max(0, atoi(value.c_str()));
+        else if(arg == "--threads") cfg.threads = std::max(1, atoi(value.c_str()));
+        else {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    generate_board_control_value_map(board_control_value_map_w, WHITE);
+    generate_board_control_value_map(board_control_value_map_b, BLACK);
+    movegen::init();
+    for(const char* fen : bench_fens) {
+        struct bench_position p;
+        board::load_fen(p.pos, fen, p.side);
+        p.pos.side = p.side;
+        positions.push_back(p);
+    }
+
+    time_op("get_moves", rounds, [](const struct bench_position& p) {
+        uint64_t calls = 0;
+        for(int type = 0; type < 6; ++type) {
+            bitb::bitboard bb = p.pos.pieces[type + p.side * _BLACK];
+            while(bb) {
+                const int square = bitb::pop_lsb(bb);
+                sink += board::get_moves(p.pos, square, type, p.side, false).size();
+                ++calls;
+            }
+        }
+        return calls;
+    });
+    time_op("get_control_map", rounds, [](const struct bench_position& p) {
+        sink += board::get_control_map(p.pos, WHITE) ^ board::get_control_map(p.pos, BLACK);
+        return (uint64_t)2;
+    });
+    time_op("movegen::generate", rounds, [](const struct bench_position& p) {
+        struct movegen::move_list list;
+        movegen::generate(p.pos, p.side, list);
+        sink += list.size;
+        return (uint64_t)1;
+    });
+    time_op("move_piece+undo", rounds, [](const struct bench_position& p) {
+        struct movegen::move_list list;
+        movegen::generate(p.pos, p.side, list);
+        struct board::position pos = p.pos;
+        for(int i = 0; i < list.size; ++i) {
+            const movegen::move m = list.moves[i];
+            const int promotion = movegen::move_promotion(m);
+            struct board::undo u;
+            board::move_piece(pos, movegen::move_from(m), movegen::move_to(m), promotion ? promotion : QUEEN, &u);
+            sink += pos.key;
+            board::undo_move(pos, u);
+        }
+        return (uint64_t)list.size;
+    });
+    time_op("eval_position", rounds, [](const struct bench_position& p) {
+        sink += eval::eval_position(p.pos);
+        return (uint64_t)1;
+    });
+    time_op("board_to_str", rounds, [](const struct bench_position& p) {
+        sink += board::board_to_str(p.pos).size();
+        return (uint64_t)1;
+    });
+
+    // Every search starts from an empty hash table, so the node counts don't depend on the order
+    cfg.use_bitbases = false;
+    engine::tt::default_table.resize(BENCH_HASH_MB, 1);
+    uint64_t signature = 0;
+    double total_ms = 0.0;
+    const bool mcts = cfg.mode == SEARCH_MCTS;
+    std::cout << "\n" << (mcts ? "MCTS on " + std::to_string(cfg.threads) + " threads" : "Alpha-beta");
+    if(time_ms > 0)
+        std::cout << ", " << time_ms << " ms per position\n";
+    else
+        std::cout << " to depth " << depth << "\n";
+    for(size_t i = 0; i < positions.size(); ++i) {
+        engine::tt::default_table.clear(1);
+        struct engine::search_limits limits = {time_ms > 0 ? MAX_PLY : depth, time_ms};
+        struct engine::search_info info;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const struct engine::engine_eval eval = engine::think(positions[i].pos, positions[i].side, limits, cfg, &info);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        total_ms += ms;
+        signature += info.nodes;
+        std::cout << "Position " << std::setw(2) << i + 1 << ": score " << std::setw(6) << eval.eval << std::setw(12) << info.nodes
+                  << " nodes " << std::setw(10) << (uint64_t)(info.nodes / std::max(ms, 1e-3) * 1000.0) << " nps\n";
+    }
+    std::cout << "Total time (ms) : " << (uint64_t)total_ms << "\n";
+    std::cout << "Nodes searched  : " << signature << "\n";
+    std::cout << "Nodes/second    : " << (uint64_t)(signature / std::max(total_ms, 1e-3) * 1000.0) << "\n";
+    if(!mcts && time_ms == 0)
+        std::cout << "Signature       : " << signature << "\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+// Search of one position split between worker processes (see src/cluster.h). The coordinator starts
+// --workers processes of this program itself, which connect back to it, and waits for --wait more which
+// are started by hand, e.g. pinned to another NUMA node with numactl. Each worker has its own --hash MB.
+// --compare runs the same search in this process afterwards, for the speedup and to check the moves agree.
+//
+// Usage: cluster [--fen FEN] [--depth N] [--time MS] [--workers N] [--wait N] [--listen ADDRESS] [--hash MB] [--compare]
+//        cluster --worker ADDRESS [--hash MB]
+// ADDRESS is unix:/path or host:port, by default a Unix domain socket in /tmp.
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../src/cluster.h"
+#include "../src/pgn.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define DEFAULT_WORKERS 2
+#define WORKER_HASH_MB 64
+
+using namespace NerdChess;
+
+static std::string score_to_str(int score) {
+    if(std::abs(score) >= MATE_SCORE - MAX_PLY)
+        return score > 0 ? "mate" : "-mate";
+    std::ostringstream str;
+    str << std::showpos << std::fixed << std::setprecision(2) << score / 100.0;
+    return str.str();
+}
+
+static std::string line_to_str(const struct board::position& root, bool side, const std::vector<movegen::move>& pv) {
+    struct board::position pos = root;
+    std::string str;
+    for(movegen::move m : pv) {
+        str += (str.empty() ? "" : " ") + pgn::to_san(pos, side, m);
+        movegen::make_move(pos, m);
+        side = !side;
+    }
+    return str;
+}
+
+static void print_progress(const struct board::position& pos, bool side, const struct engine::search_info& info) {
+    std::cout << "depth " << std::setw(2) << info.depth << std::setw(12) << info.nodes << " nodes" << std::setw(8) << info.time_ms << " ms  "
+              << std::setw(6) << score_to_str(info.score) << "  " << line_to_str(pos, side, info.pv) << "\n";
+}
+
+// Starts a worker process running this program with --worker
+static pid_t spawn_worker(const char* program, const std::string& address, int hash_mb) {
+    const pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+    const std::string hash = std::to_string(hash_mb);
+    execlp(program, program, "--worker", address.c_str(), "--hash", hash.c_str(), (char*)nullptr);
+    std::cerr << "Could not start " << program << "\n";
+    _exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    std::string fen = START_FEN;
+    struct engine::search_limits limits = {7, 0};
+    int spawn = DEFAULT_WORKERS, wait = 0;
+    int hash_mb = WORKER_HASH_MB;
+    std::string address = "unix:/tmp/nerdchess-cluster-" + std::to_string(getpid()) + ".sock";
+    std::string worker_address;
+    bool compare = false;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--compare") {
+            compare = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--fen") fen = value;
+        else if(arg == "--depth") limits.depth = std::max(1, atoi(value.c_str()));
+        else if(arg == "--time") limits.time_ms = std::max(0, atoi(value.c_str()));
+        else if(arg == "--workers") spawn = std::max(0, atoi(value.c_str()));
+        else if(arg == "--wait") wait = std::max(0, atoi(value.c_str()));
+        else if(arg == "--listen") address = value;
+        else if(arg == "--hash") hash_mb = std::max(0, atoi(value.c_str()));
+        else if(arg == "--worker") worker_address = value;
+        else {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    generate_board_control_value_map(board_control_value_map_w, WHITE);
+    generate_board_control_value_map(board_control_value_map_b, BLACK);
+    movegen::init();
+    struct engine::config cfg = engine::get_default_config();
+    cfg.use_bitbases = false; // Not generated here, see match --bitbases
+    engine::tt::default_table.resize(hash_mb, 1);
+    cfg.use_hash = engine::tt::default_table.buckets != nullptr;
+
+    if(!worker_address.empty()) {
+        const int fd = engine::cluster::connect_to(worker_address, CLUSTER_CONNECT_TIMEOUT_MS);
+        if(fd < 0) {
+            std::cerr << "Could not connect to " << worker_address << "\n";
+            return EXIT_FAILURE;
+        }
+        engine::cluster::run_worker(fd, cfg);
+        engine::cluster::close_socket(fd);
+        return EXIT_SUCCESS;
+    }
+
+    struct board::position pos;
+    bool side;
+    if(!board::load_fen(pos, fen, side)) {
+        std::cerr << "Invalid FEN " << fen << "\n";
+        return EXIT_FAILURE;
+    }
+    if(spawn + wait == 0) {
+        std::cerr << "No workers\n";
+        return EXIT_FAILURE;
+    }
+
+    const int listener = engine::cluster::listen_on(address);
+    if(listener < 0) {
+        std::cerr << "Could not listen on " << address << "\n";
+        return EXIT_FAILURE;
+    }
+    std::vector<pid_t> children;
+    for(int i = 0; i < spawn; ++i)
+        children.push_back(spawn_worker(argv[0], address, hash_mb));
+    if(wait > 0)
+        std::cout << "Waiting for " << wait << " worker(s) on " << address << "\n";
+    std::vector<int> workers;
+    while((int)workers.size() < spawn + wait) {
+        const int fd = engine::cluster::accept_worker(listener, wait > 0 ? -1 : CLUSTER_CONNECT_TIMEOUT_MS);
+        if(fd < 0)
+            break;
+        workers.push_back(fd);
+    }
+    engine::cluster::close_socket(listener);
+    if(address.compare(0, 5, "unix:") == 0)
+        unlink(address.c_str() + 5);
+    std::cout << workers.size() << " worker(s) connected\n";
+
+    struct engine::search_control control;
+    control.stop = nullptr;
+    control.on_progress = [&pos, side](const struct engine::search_info& info) { print_progress(pos, side, info); };
+    struct engine::search_info info;
+    const struct engine::engine_eval eval = engine::cluster::think(workers, pos, side, limits, &info, &control);
+    std::cout << "Best move " << (eval.move != NO_MOVE ? pgn::to_san(pos, side, eval.move) : "none") << ", " << info.nodes << " nodes, "
+              << info.time_ms << " ms\n";
+
+    // Closing the connections ends the workers
+    for(int fd : workers)
+        engine::cluster::close_socket(fd);
+    for(pid_t child : children)
+        waitpid(child, nullptr, 0);
+
+    if(compare) {
+        std::cout << "\nOne process\n";
+        struct engine::search_info single;
+        const struct engine::engine_eval single_eval = engine::think(pos, side, limits, cfg, &single, &control);
+        std::cout << "Best move " << (single_eval.move != NO_MOVE ? pgn::to_san(pos, side, single_eval.move) : "none") << ", " << single.nodes
+                  << " nodes, " << single.time_ms << " ms, " << std::fixed << std::setprecision(2)
+                  << (double)single.time_ms / std::max<int64_t>(info.time_ms, 1) << "x the time of the split search\n";
+    }
+    return EXIT_SUCCESS;
+}
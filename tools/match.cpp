@@ -0,0 +1,375 @@
+// Self-play match runner: plays two engine configurations against each other on every core, with both
+// colors from every opening, until a sequential probability ratio test (SPRT) accepts one of its hypotheses.
+//
+// Usage: match [--games N] [--threads N] [--tc base+inc] [--depth N] [--openings file]
+//              [--a key=value,...] [--b key=value,...] [--elo0 E] [--elo1 E] [--alpha A] [--beta B] [--bitbases] [--hash MB]
+//              [--params FILE] [--record FILE]
+// Configuration keys: bitbases=0|1, hash=0|1, depth=N, prune=0|1, futility=N, rfp=N, razor=N (margins in centipawns per ply),
+//                     mcts=0|1, threads=N, cpuct=N (hundredths), playout=N (see mcts.h), params=FILE
+// Every game thread gives each engine a hash table of its own, cleared before each game, which share the --hash MB
+// (default TT_DEFAULT_MB) between them. The eval parameters are those from --params, with an engine's params=FILE
+// loaded on top of them for that engine only.
+// --record appends every game to a binary game record file (see record.h), engine A is player 0 and B player 1.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <math.h>
+#include "../src/engine.h"
+#include "../src/record.h"
+
+#define MAX_GAME_PLIES 400
+
+using namespace NerdChess;
+
+// Played twice each, with both colors
+static const char* default_openings[] = {
+    "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1", // 1. e4
+    "rnbqkbnr/pppppppp/8/8/3P4/8/PPP1PPPP/RNBQKBNR b KQkq - 0 1", // 1. d4
+    "rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b KQkq - 0 1", // 1. c4
+    "rnbqkbnr/pppppppp/8/8/8/5N2/PPPPPPPP/RNBQKB1R b KQkq - 1 1", // 1. Nf3
+    "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2", // 1. e4 e5
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2", // 1. e4 c5
+    "rnbqkbnr/pppp1ppp/4p3/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2", // 1. e4 e6
+    "rnbqkbnr/pp1ppppp/2p5/8/4P3/8/PPPP1PPP/RNBQKBNR w KQkq - 0 2", // 1. e4 c6
+    "rnbqkbnr/ppp1pppp/8/3p4/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 0 2", // 1. d4 d5
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq - 1 2", // 1. d4 Nf6
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3", // 1. e4 e5 2. Nf3 Nc6
+    "rnbqkb1r/pppp1ppp/4pn2/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3", // 1. d4 Nf6 2. c4 e6
+    "rnbqkbnr/pp2pppp/3p4/2p5/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 0 3", // 1. e4 c5 2. Nf3 d6
+    "rnbqkbnr/ppp2ppp/4p3/3p4/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3", // 1. d4 d5 2. c4 e6
+    "rnbqkbnr/pp2pppp/2p5/3p4/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3", // 1. d4 d5 2. c4 c6
+    "rnbqkb1r/pppppp1p/5np1/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq - 0 3", // 1. d4 Nf6 2. c4 g6
+};
+
+struct player {
+    std::string name;
+    struct engine::config cfg;
+    int depth;
+    std::string params_file;
+    int params[eval::PARAM_COUNT]; // cfg.params with params_file
+    // Totals over all moves, only touched while holding results_mutex
+    uint64_t nodes;
+    int64_t time_ms;
+    uint64_t depth_sum;
+    uint64_t moves;
+};
+
+struct match_settings {
+    int games;
+    int threads;
+    int base_ms; // Time control: base time per game and increment per move
+    int inc_ms;
+    double elo0, elo1, alpha, beta;
+};
+
+static struct player players[2];
+static struct match_settings settings;
+static std::vector<std::string> openings;
+static std::mutex results_mutex;
+static int wins = 0, draws = 0, losses = 0; // From the point of view of engine A
+static std::atomic<int> next_game(0);
+static std::atomic<bool> finished(false);
+static struct record::writer games_file;
+static bool recording = false;
+
+static double elo_from_score(double score) {
+    score = std::min(std::max(score, 1e-6), 1.0 - 1e-6);
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static double score_from_elo(double elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+// Log-likelihood ratio of H1 (elo1) against H0 (elo0) for the trinomial results, using the
+// usual normal approximation of the score distribution
+static double sprt_llr(int w, int d, int l, double elo0, double elo1) {
+    const double n = w + d + l;
+    if(n == 0 || w == 0 || l == 0)
+        return 0.0;
+    const double score = (w + 0.5 * d) / n;
+    const double variance = (w * pow(1.0 - score, 2) + d * pow(0.5 - score, 2) + l * pow(score, 2)) / n;
+    const double s0 = score_from_elo(elo0);
+    const double s1 = score_from_elo(elo1);
+    return (s1 - s0) * (2.0 * score - s0 - s1) * n / (2.0 * variance);
+}
+
+static bool insufficient_material(const struct board::position& pos) {
+    const bitb::bitboard heavy = pos.pieces[PAWN] | pos.pieces[ROOK] | pos.pieces[QUEEN] | pos.pieces[PAWN+_BLACK] | pos.pieces[ROOK+_BLACK] | pos.pieces[QUEEN+_BLACK];
+    const bitb::bitboard minors = pos.pieces[KNIGHT] | pos.pieces[BISHOP] | pos.pieces[KNIGHT+_BLACK] | pos.pieces[BISHOP+_BLACK];
+    return !heavy && bitb::popcount(minors) <= 1;
+}
+
+// Plays one game, returns 1 if white won, -1 if black won and 0 for a draw. The moves go to g, how the game
+// ended to termination (RECORD_END_*). hash holds the tables of white and black.
+static int play_game(const std::string& fen, struct player* white, struct player* black, engine::tt::hash_table* hash[2], struct pgn::game& g,
+                     int& termination) {
+    struct board::position pos;
+    bool side;
+    board::load_fen(pos, fen, side);
+    g.start = pos;
+    g.start_side = side;
+    g.moves.clear();
+    termination = RECORD_END_MAX_PLIES;
+    std::vector<uint64_t> history; // Hash of every position before the current one
+    int clock[2] = {settings.base_ms, settings.base_ms};
+
+    for(int ply = 0; ply < MAX_GAME_PLIES; ++ply) {
+        struct movegen::move_list moves;
+        movegen::generate(pos, side, moves);
+        if(moves.size == 0) {
+            termination = movegen::in_check(pos, side) ? RECORD_END_MATE : RECORD_END_STALEMATE;
+            return termination == RECORD_END_MATE ? (side == WHITE ? -1 : 1) : 0;
+        }
+        if(insufficient_material(pos) || pos.halfmove_clock >= 100 || std::count(history.begin(), history.end(), pos.key) >= 2) {
+            termination = insufficient_material(pos) ? RECORD_END_MATERIAL : pos.halfmove_clock >= 100 ? RECORD_END_FIFTY_MOVES : RECORD_END_REPETITION;
+            return 0;
+        }
+
+        struct player* p = side == WHITE ? white : black;
+        struct engine::search_limits limits;
+        struct engine::search_info info;
+        limits.depth = p->depth;
+        limits.time_ms = std::max(1, clock[side] / 25 + settings.inc_ms * 4 / 5);
+        struct engine::config cfg = p->cfg;
+        cfg.hash = hash[side];
+        const struct engine::engine_eval eval = engine::think(pos, side, limits, cfg, &info, nullptr, &history);
+
+        clock[side] -= info.time_ms;
+        if(clock[side] < 0) {
+            termination = RECORD_END_TIME;
+            return side == WHITE ? -1 : 1; // Lost on time
+        }
+        clock[side] += settings.inc_ms;
+
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            p->nodes += info.nodes;
+            p->time_ms += info.time_ms;
+            p->depth_sum += info.depth;
+            p->moves++;
+        }
+
+        history.push_back(pos.key);
+        g.moves.push_back(eval.move);
+        movegen::make_move(pos, eval.move);
+        side = !side;
+    }
+    return 0;
+}
+
+static void print_report() {
+    const int n = wins + draws + losses;
+    const double score = n ? (wins + 0.5 * draws) / n : 0.5;
+    const double variance = n ? (wins * pow(1.0 - score, 2) + draws * pow(0.5 - score, 2) + losses * pow(score, 2)) / n : 0.0;
+    const double margin = 1.96 * sqrt(variance / std::max(n, 1));
+    const double elo = elo_from_score(score);
+    const double elo_error = (elo_from_score(score + margin) - elo_from_score(score - margin)) / 2.0;
+
+    std::cout << "Games: " << n << " (A: +" << wins << " =" << draws << " -" << losses << ")\n";
+    std::cout << "Elo (A - B): " << elo << " +/- " << elo_error << "\n";
+    std::cout << "LLR: " << sprt_llr(wins, draws, losses, settings.elo0, settings.elo1)
+              << " (bounds " << log(settings.beta / (1.0 - settings.alpha)) << ", " << log((1.0 - settings.beta) / settings.alpha) << ")\n";
+    for(int i = 0; i < 2; ++i) {
+        const struct player& p = players[i];
+        std::cout << p.name << ": " << (p.time_ms ? p.nodes * 1000 / p.time_ms : 0) << " nps, average depth "
+                  << (p.moves ? (double)p.depth_sum / p.moves : 0.0) << "\n";
+    }
+}
+
+static void worker(int hash_mb) {
+    // Engine A's and B's, so that neither sees the other's entries
+    engine::tt::hash_table tables[2];
+    for(engine::tt::hash_table& table : tables)
+        table.resize(hash_mb, 1);
+
+    while(!finished) {
+        const int game = next_game++;
+        if(game >= settings.games)
+            break;
+
+        // Every opening is played twice so that both engines get both colors
+        const std::string& fen = openings[(game / 2) % openings.size()];
+        const bool a_is_white = game % 2 == 0;
+        struct pgn::game g;
+        int termination;
+        for(engine::tt::hash_table& table : tables)
+            table.clear(1);
+        engine::tt::hash_table* hash[2] = {a_is_white ? &tables[0] : &tables[1], a_is_white ? &tables[1] : &tables[0]};
+        const int result = play_game(fen, a_is_white ? &players[0] : &players[1], a_is_white ? &players[1] : &players[0], hash, g, termination);
+        const int a_result = a_is_white ? result : -result;
+        if(recording) {
+            g.result = result;
+            if(!games_file.write(g, a_is_white ? 0 : 1, a_is_white ? 1 : 0, termination))
+                std::cerr << "Could not record game " << game << "\n";
+        }
+
+        std::lock_guard<std::mutex> lock(results_mutex);
+        if(a_result > 0)
+            wins++;
+        else if(a_result < 0)
+            losses++;
+        else
+            draws++;
+
+        const double llr = sprt_llr(wins, draws, losses, settings.elo0, settings.elo1);
+        std::cout << "Game " << (wins + draws + losses) << ": +" << wins << " =" << draws << " -" << losses << ", LLR " << llr << "\n";
+        if(llr >= log((1.0 - settings.beta) / settings.alpha) || llr <= log(settings.beta / (1.0 - settings.alpha)))
+            finished = true;
+    }
+}
+
+// Parses "bitbases=0,depth=6,params=tuned.txt"
+static bool parse_config(const std::string& str, struct player& p) {
+    std::string item;
+    std::istringstream stream(str);
+    while(std::getline(stream, item, ',')) {
+        const size_t eq = item.find('=');
+        if(eq == std::string::npos)
+            return false;
+        const std::string key = item.substr(0, eq);
+        const int value = atoi(item.substr(eq + 1).c_str());
+        if(key == "bitbases")
+            p.cfg.use_bitbases = value;
+        else if(key == "hash")
+            p.cfg.use_hash = value;
+        else if(key == "depth")
+            p.depth = value;
+        else if(key == "prune")
+            p.cfg.use_pruning = value;
+        else if(key == "futility")
+            p.cfg.futility_margin = value;
+        else if(key == "rfp")
+            p.cfg.reverse_futility_margin = value;
+        else if(key == "razor")
+            p.cfg.razor_margin = value;
+        else if(key == "mcts")
+            p.cfg.mode = value ? SEARCH_MCTS : SEARCH_ALPHA_BETA;
+        else if(key == "threads")
+            p.cfg.threads = std::max(1, value);
+        else if(key == "cpuct")
+            p.cfg.mcts_cpuct = value;
+        else if(key == "playout")
+            p.cfg.mcts_playout = std::max(0, value);
+        else if(key == "params")
+            p.params_file = item.substr(eq + 1);
+        else
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    bool bitbases = false;
+    int hash_mb = TT_DEFAULT_MB;
+    std::string openings_file, params_file;
+    settings.games = 20000;
+    settings.threads = std::max(1u, std::thread::hardware_concurrency());
+    settings.base_ms = 10000;
+    settings.inc_ms = 100;
+    settings.elo0 = 0.0;
+    settings.elo1 = 5.0;
+    settings.alpha = 0.05;
+    settings.beta = 0.05;
+    for(int i = 0; i < 2; ++i) {
+        players[i].name = i ? "B" : "A";
+        players[i].cfg = engine::get_default_config();
+        players[i].depth = 64;
+    }
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const std::string value = i + 1 < argc ? argv[i + 1] : "";
+        bool ok = true;
+        if(arg == "--bitbases") {
+            bitbases = true;
+            continue;
+        }
+        if(value.empty()) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        ++i;
+        if(arg == "--games") settings.games = atoi(value.c_str());
+        else if(arg == "--threads") settings.threads = std::max(1, atoi(value.c_str()));
+        else if(arg == "--tc") {
+            const size_t plus = value.find('+');
+            settings.base_ms = atof(value.c_str()) * 1000;
+            settings.inc_ms = plus == std::string::npos ? 0 : atof(value.c_str() + plus + 1) * 1000;
+        }
+        else if(arg == "--depth") players[0].depth = players[1].depth = atoi(value.c_str());
+        else if(arg == "--openings") openings_file = value;
+        else if(arg == "--params") params_file = value;
+        else if(arg == "--record") {
+            recording = games_file.open(value);
+            ok = recording;
+        }
+        else if(arg == "--hash") hash_mb = std::max(0, atoi(value.c_str()));
+        else if(arg == "--a") ok = parse_config(value, players[0]);
+        else if(arg == "--b") ok = parse_config(value, players[1]);
+        else if(arg == "--elo0") settings.elo0 = atof(value.c_str());
+        else if(arg == "--elo1") settings.elo1 = atof(value.c_str());
+        else if(arg == "--alpha") settings.alpha = atof(value.c_str());
+        else if(arg == "--beta") settings.beta = atof(value.c_str());
+        else ok = false;
+        if(!ok) {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    generate_board_control_value_map(board_control_value_map_w, WHITE);
+    generate_board_control_value_map(board_control_value_map_b, BLACK);
+    movegen::init();
+    if(!params_file.empty() && !eval::load_params(params_file)) {
+        std::cerr << "Could not load " << params_file << "\n";
+        return EXIT_FAILURE;
+    }
+    for(struct player& p : players) {
+        if(p.params_file.empty())
+            continue;
+        std::copy(eval::params, eval::params + eval::PARAM_COUNT, p.params);
+        if(!eval::load_params(p.params_file, p.params)) {
+            std::cerr << "Could not load " << p.params_file << "\n";
+            return EXIT_FAILURE;
+        }
+        p.cfg.params = p.params;
+    }
+    if(bitbases)
+        bitbase::init({"KPK", "KRK", "KQK", "KQKR", "KBNK"}, settings.threads, "NerdChess.bb");
+
+    if(!openings_file.empty()) {
+        std::ifstream file(openings_file);
+        std::string line;
+        struct board::position pos;
+        bool side;
+        while(std::getline(file, line))
+            if(board::load_fen(pos, line, side))
+                openings.push_back(line);
+    } else {
+        openings.assign(std::begin(default_openings), std::end(default_openings));
+    }
+    if(openings.empty()) {
+        std::cerr << "No openings\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < settings.threads; ++i)
+        threads.emplace_back(worker, hash_mb > 0 ? std::max(1, hash_mb / (2 * settings.threads)) : 0);
+    for(std::thread& thread : threads)
+        thread.join();
+
+    if(recording) {
+        games_file.close();
+        std::cout << "Recorded " << games_file.games() << " games\n";
+    }
+    print_report();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+// Parallel perft: counts the leaf nodes of the legal move tree to check the move generator against
+// published numbers. The subtrees below the first two plies are spread over all cores, transposed
+// subtrees are looked up in a shared hash table and the last ply is counted straight from the move list.
+//
+// Usage: perft [--fen FEN] [--depth N] [--threads N] [--hash MB] [--divide]
+//        perft --suite [--threads N] [--hash MB]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "../src/movegen.h"
+
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+using namespace NerdChess;
+
+// Published results, see https://www.chessprogramming.org/Perft_Results
+static const struct {
+    const char* fen;
+    int depth;
+    uint64_t nodes;
+} suite[] = {
+    {START_FEN, 6, 119060324ULL},
+    {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690ULL},
+    {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 7, 178633661ULL},
+    {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5, 15833292ULL},
+    {"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 5, 15833292ULL},
+    {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5, 89941194ULL},
+    {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5, 164075551ULL},
+};
+
+// Shared by all threads without locks. The key is stored xor'ed with the data, so an entry
+// which was torn by two threads writing at the same time simply doesn't match any more.
+struct perft_entry {
+    std::atomic<uint64_t> check; // key ^ data
+    std::atomic<uint64_t> data; // Node count in the upper 56 bits, depth in the lower 8
+};
+
+static std::vector<struct perft_entry> table;
+static uint64_t table_mask = 0;
+
+// One subtree to be counted by a worker
+struct work_item {
+    struct board::position pos;
+    bool side;
+    int root; // Index of the root move this subtree belongs to
+};
+
+static std::vector<struct work_item> work;
+static std::vector<std::atomic<uint64_t>> root_nodes;
+static std::atomic<size_t> next_item(0);
+
+static void init_table(size_t mb) {
+    size_t entries = 1;
+    while(entries * 2 * sizeof(struct perft_entry) <= mb * 1024 * 1024)
+        entries *= 2;
+    table = std::vector<struct perft_entry>(mb ? entries : 0);
+    table_mask = entries - 1;
+}
+
+template<bool Us>
+static uint64_t perft(const struct board::position& pos, int depth) {
+    struct movegen::move_list list;
+    movegen::generate<Us>(pos, list);
+    if(depth <= 1)
+        return list.size; // Bulk counting, the last ply is never made
+
+    struct perft_entry* entry = nullptr;
+    if(!table.empty()) {
+        entry = &table[pos.key & table_mask];
+        const uint64_t data = entry->data.load(std::memory_order_relaxed);
+        if((entry->check.load(std::memory_order_relaxed) ^ data) == pos.key && (int)(data & 0xff) == depth)
+            return data >> 8;
+    }
+
+    uint64_t nodes = 0;
+    for(int i = 0; i < list.size; ++i) {
+        struct board::position next = pos;
+        movegen::make_move(next, list.moves[i]);
+        nodes += perft<!Us>(next, depth - 1);
+    }
+
+    if(entry) {
+        const uint64_t data = (nodes << 8) | depth;
+        entry->data.store(data, std::memory_order_relaxed);
+        entry->check.store(pos.key ^ data, std::memory_order_relaxed);
+    }
+    return nodes;
+}
+
+static void worker(int depth) {
+    size_t i;
+    while((i = next_item++) < work.size()) {
+        const struct work_item& item = work[i];
+        root_nodes[item.root] += item.side ? perft<BLACK>(item.pos, depth) : perft<WHITE>(item.pos, depth);
+    }
+}
+
+static std::string move_to_str(movegen::move m) {
+    std::string str;
+    for(int sq : {movegen::move_from(m), movegen::move_to(m)}) {
+        str += (char)('a' + sq % 8);
+        str += (char)('8' - sq / 8);
+    }
+    if(movegen::move_promotion(m))
+        str += "pnbrqk"[movegen::move_promotion(m)];
+    return str;
+}
+
+// Counts the leaves of a position on every thread. With divide the count below every root move is printed as well.
+static uint64_t run(const struct board::position& pos, bool side, int depth, int threads, bool divide) {
+    struct movegen::move_list root;
+    movegen::generate(pos, side, root);
+    if(depth <= 1)
+        return depth == 1 ? root.size : 1;
+
+    // Two plies give enough subtrees to keep every thread busy until the end
+    const int split = depth >= 4 ? 2 : 1;
+    work.clear();
+    for(int i = 0; i < root.size; ++i) {
+        struct work_item item = {pos, !side, i};
+        movegen::make_move(item.pos, root.moves[i]);
+        if(split == 1) {
+            work.push_back(item);
+            continue;
+        }
+        struct movegen::move_list replies;
+        movegen::generate(item.pos, item.side, replies);
+        for(int j = 0; j < replies.size; ++j) {
+            struct work_item reply = {item.pos, side, i};
+            movegen::make_move(reply.pos, replies.moves[j]);
+            work.push_back(reply);
+        }
+    }
+
+    root_nodes = std::vector<std::atomic<uint64_t>>(root.size);
+    next_item = 0;
+    std::vector<std::thread> pool;
+    for(int i = 0; i < threads; ++i)
+        pool.emplace_back(worker, depth - split);
+    for(std::thread& thread : pool)
+        thread.join();
+
+    uint64_t nodes = 0;
+    for(int i = 0; i < root.size; ++i) {
+        if(divide)
+            std::cout << move_to_str(root.moves[i]) << ": " << root_nodes[i] << "\n";
+        nodes += root_nodes[i];
+    }
+    return nodes;
+}
+
+int main(int argc, char* argv[]) {
+    std::string fen = START_FEN;
+    int depth = 6;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t hash_mb = 256;
+    bool divide = false, run_suite = false;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--divide") {
+            divide = true;
+            continue;
+        }
+        if(arg == "--suite") {
+            run_suite = true;
+            continue;
+        }
+        if(i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        const std::string value = argv[++i];
+        if(arg == "--fen") fen = value;
+        else if(arg == "--depth") depth = atoi(value.c_str());
+        else if(arg == "--threads") threads = std::max(1, atoi(value.c_str()));
+        else if(arg == "--hash") hash_mb = atoi(value.c_str());
+        else {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    movegen::init();
+    init_table(hash_mb);
+
+    int failed = 0;
+    const int count = run_suite ? sizeof(suite) / sizeof(suite[0]) : 1;
+    for(int i = 0; i < count; ++i) {
+        const std::string position_fen = run_suite ? suite[i].fen : fen;
+        const int position_depth = run_suite ? suite[i].depth : depth;
+        struct board::position pos;
+        bool side;
+        if(!board::load_fen(pos, position_fen, side)) {
+            std::cerr << "Invalid FEN " << position_fen << "\n";
+            return EXIT_FAILURE;
+        }
+
+        // Entries from another position are harmless, but would make the timings meaningless
+        for(struct perft_entry& entry : table)
+            entry.check = entry.data = 0;
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const uint64_t nodes = run(pos, side, position_depth, threads, divide && !run_suite);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << position_fen << "\n  depth " << position_depth << ": " << nodes << " nodes, " << seconds << " s, "
+                  << (uint64_t)(nodes / std::max(seconds, 1e-9)) << " nps";
+        if(run_suite) {
+            const bool ok = nodes == suite[i].nodes;
+            failed += !ok;
+            std::cout << (ok ? " OK" : " FAILED, expected " + std::to_string(suite[i].nodes));
+        }
+        std::cout << "\n";
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+// PGN reader benchmark and statistics: streams a game collection through pgn::read_file on every core and
+// reports the throughput, results and (with --unique) the number of distinct positions.
+//
+// Usage: pgn FILE [--threads N] [--unique] [--errors]
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include "../src/pgn.h"
+
+#define UNIQUE_SHARDS 64
+
+using namespace NerdChess;
+
+// Position hashes, split over several sets so the workers rarely wait for each other
+static std::unordered_set<uint64_t> unique_keys[UNIQUE_SHARDS];
+static std::mutex unique_mutexes[UNIQUE_SHARDS];
+static std::mutex print_mutex;
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool unique = false, errors = false;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc)
+            threads = std::max(1, atoi(argv[++i]));
+        else if(arg == "--unique")
+            unique = true;
+        else if(arg == "--errors")
+            errors = true;
+        else if(arg[0] != '-' && path.empty())
+            path = arg;
+        else {
+            std::cerr << "Invalid argument " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(path.empty()) {
+        std::cerr << "Usage: pgn FILE [--threads N] [--unique] [--errors]\n";
+        return EXIT_FAILURE;
+    }
+
+    movegen::init();
+    const struct pgn::read_stats stats = pgn::read_file(path, threads, [unique, errors](const struct pgn::game& g) {
+        if(errors && !g.error.empty()) {
+            std::lock_guard<std::mutex> lock(print_mutex);
+            std::cerr << g.error << " after " << g.moves.size() << " plies\n";
+        }
+        if(unique) {
+            for(uint64_t key : g.keys) {
+                const int shard = key % UNIQUE_SHARDS;
+                std::lock_guard<std::mutex> lock(unique_mutexes[shard]);
+                unique_keys[shard].insert(key);
+            }
+        }
+    });
+    if(!stats.opened) {
+        std::cerr << "Could not open " << path << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Games: " << stats.games << " (" << stats.bad_games << " with errors)\n";
+    std::cout << "Results: +" << stats.results[2] << " =" << stats.results[1] << " -" << stats.results[0] << "\n";
+    std::cout << "Moves: " << stats.moves << "\n";
+    if(unique) {
+        size_t count = 0;
+        for(int i = 0; i < UNIQUE_SHARDS; ++i)
+            count += unique_keys[i].size();
+        std::cout << "Distinct positions: " << count << "\n";
+    }
+    std::cout << "Time: " << stats.seconds << " s, " << (uint64_t)(stats.games / std::max(stats.seconds, 1e-9)) << " games/s, "
+              << stats.bytes / std::max(stats.seconds, 1e-9) / (1024 * 1024) << " MB/s\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+// Binary game records (see src/record.h): converts a PGN file into one, scans one on every core with the
+// same statistics as tools/pgn.cpp for comparing the throughput, or prints a single game.
+//
+// Usage: records FILE [--threads N] [--headers] [--game N] [--convert PGN]
+// --convert appends the games of PGN to FILE, --headers only reads the game headers (results, no moves).
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "../src/record.h"
+
+using namespace NerdChess;
+
+static const char* result_names[] = {"0-1", "1/2-1/2", "1-0", "*"};
+
+// Movetext in SAN, with move numbers
+static std::string game_to_str(const struct pgn::game& g) {
+    struct board::position pos = g.start;
+    bool side = g.start_side;
+    std::string str;
+    for(size_t ply = 0; ply < g.moves.size(); ++ply) {
+        if(side == WHITE || ply == 0)
+            str += std::to_string((ply + g.start_side) / 2 + 1) + (side == WHITE ? ". " : "... ");
+        str += pgn::to_san(pos, side, g.moves[ply]) + " ";
+        movegen::make_move(pos, g.moves[ply]);
+        side = !side;
+    }
+    return str + result_names[g.result + 1];
+}
+
+int main(int argc, char* argv[]) {
+    std::string path, convert;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    bool headers = false;
+    int64_t game = -1;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc)
+            threads = std::max(1, atoi(argv[++i]));
+        else if(arg == "--game" && i + 1 < argc)
+            game = atoll(argv[++i]);
+        else if(arg == "--convert" && i + 1 < argc)
+            convert = argv[++i];
+        else if(arg == "--headers")
+            headers = true;
+        else if(arg[0] != '-' && path.empty())
+            path = arg;
+        else {
+            std::cerr << "Invalid argument " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(path.empty()) {
+        std::cerr << "Usage: records FILE [--threads N] [--headers] [--game N] [--convert PGN]\n";
+        return EXIT_FAILURE;
+    }
+
+    movegen::init();
+
+    if(!convert.empty()) {
+        struct record::writer writer;
+        if(!writer.open(path)) {
+            std::cerr << "Could not open " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        std::atomic<uint64_t> skipped(0);
+        const struct pgn::read_stats stats = pgn::read_file(convert, threads, [&writer, &skipped](const struct pgn::game& g) {
+            // A broken game is only kept up to its bad move, which would change its meaning
+            if(!g.error.empty() || !writer.write(g))
+                skipped++;
+        });
+        writer.close();
+        if(!stats.opened) {
+            std::cerr << "Could not open " << convert << "\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "Converted " << writer.games() << " games (" << skipped << " skipped) in " << stats.seconds << " s\n";
+        struct record::reader reader;
+        if(reader.open(path))
+            std::cout << stats.bytes << " bytes of PGN, " << path << " is " << reader.used() << " bytes with " << reader.size() << " games\n";
+        return EXIT_SUCCESS;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    struct record::reader reader;
+    if(!reader.open(path)) {
+        std::cerr << path << " is not a game record file of version " << RECORD_VERSION << "\n";
+        return EXIT_FAILURE;
+    }
+
+    if(game >= 0) {
+        struct record::game_header header;
+        struct pgn::game g;
+        if(!reader.read(game, header, g)) {
+            std::cerr << (g.error.empty() ? "No game " + std::to_string(game) : g.error) << "\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "Players " << (int)header.white << " - " << (int)header.black << ", termination " << (int)header.termination << "\n"
+                  << game_to_str(g) << "\n";
+        return EXIT_SUCCESS;
+    }
+
+    std::atomic<uint64_t> moves(0);
+    std::atomic<uint64_t> results[4] = {};
+    const uint64_t bad = reader.scan(threads, [&moves, &results](const struct record::game_header& header, const struct pgn::game&) {
+        moves += header.plies;
+        results[std::min<int>(std::max<int>(header.result + 1, 0), 3)]++;
+    }, !headers);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "Games: " << reader.size() << " (" << bad << " with errors)\n";
+    std::cout << "Results: +" << results[2] << " =" << results[1] << " -" << results[0] << "\n";
+    std::cout << "Moves: " << moves << "\n";
+    std::cout << "Time: " << seconds << " s, " << (uint64_t)(reader.size() / std::max(seconds, 1e-9)) << " games/s, "
+              << reader.used() / std::max(seconds, 1e-9) / (1024 * 1024) << " MB/s\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+// Summary of a search trace written with trace::open (see src/trace.h, analyze --trace): where the nodes went
+// by ply and by root move, how the nodes at every ply returned, and the largest subtrees below the root
+// moves, which is where a blow-up shows.
+//
+// Usage: trace FILE [--top N]
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+#include "../src/trace.h"
+
+#define DEFAULT_TOP 20
+#define READ_RECORDS 65536
+
+using namespace NerdChess;
+
+static const char* reason_names[TRACE_REASONS] = {"full", "cut", "hash", "mate", "draw", "leaf", "bb", "rfp", "razor", "stop"};
+
+struct ply_summary {
+    uint64_t records = 0;
+    uint64_t nodes = 0; // Subtree nodes of the recorded nodes
+    uint32_t max_nodes = 0;
+    uint64_t reasons[TRACE_REASONS] = {0};
+};
+
+struct root_summary {
+    uint64_t searches = 0; // Once per iteration (and per re-search)
+    uint64_t nodes = 0;
+    int depth = -1; // Deepest search of the move and its score
+    int score = 0;
+};
+
+// Coordinates, square 0 is a8
+static std::string move_to_str(movegen::move m) {
+    if(m == NO_MOVE)
+        return "-";
+    std::string str;
+    for(int square : {movegen::move_from(m), movegen::move_to(m)}) {
+        str += (char)('a' + square % 8);
+        str += (char)('8' - square / 8);
+    }
+    if(movegen::move_promotion(m))
+        str += " nbrq"[movegen::move_promotion(m)];
+    return str;
+}
+
+static std::string bound_to_str(int32_t bound) {
+    if(bound == INT32_MAX)
+        return "inf";
+    if(bound == -INT32_MAX)
+        return "-inf";
+    return std::to_string(bound);
+}
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    size_t top = DEFAULT_TOP;
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if(arg == "--top" && i + 1 < argc)
+            top = std::max(0, atoi(argv[++i]));
+        else if(arg[0] != '-' && path.empty())
+            path = arg;
+        else {
+            std::cerr << "Invalid argument " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(path.empty()) {
+        std::cerr << "Usage: trace FILE [--top N]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    struct engine::trace::file_header header;
+    if(!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "NCTRACE1", 8) != 0) {
+        std::cerr << path << " is not a trace file\n";
+        return EXIT_FAILURE;
+    }
+    if(header.version != TRACE_VERSION || header.record_size != sizeof(struct engine::trace::record)) {
+        std::cerr << path << " was written by another version (" << header.version << ")\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<struct ply_summary> plies;
+    std::map<movegen::move, struct root_summary> roots;
+    std::vector<struct engine::trace::record> largest; // Min-heap on nodes of the top deep subtrees
+    const auto larger = [](const struct engine::trace::record& a, const struct engine::trace::record& b) { return a.nodes > b.nodes; };
+    uint64_t total = 0;
+    int threads = 0;
+
+    // Streamed, a trace of a long search doesn't fit in memory
+    std::vector<struct engine::trace::record> records(READ_RECORDS);
+    while(file) {
+        file.read((char*)records.data(), records.size() * sizeof(struct engine::trace::record));
+        const size_t count = file.gcount() / sizeof(struct engine::trace::record);
+        for(size_t i = 0; i < count; ++i) {
+            const struct engine::trace::record& r = records[i];
+            ++total;
+            threads = std::max(threads, r.thread + 1);
+            if(r.ply >= plies.size())
+                plies.resize(r.ply + 1);
+            struct ply_summary& p = plies[r.ply];
+            p.records++;
+            p.nodes += r.nodes;
+            p.max_nodes = std::max(p.max_nodes, r.nodes);
+            p.reasons[std::min<int>(r.reason, TRACE_REASONS - 1)]++;
+
+            if(r.ply == 1) {
+                struct root_summary& root = roots[r.move];
+                root.searches++;
+                root.nodes += r.nodes;
+                if(r.depth >= root.depth) {
+                    root.depth = r.depth;
+                    root.score = r.score;
+                }
+            } else if(r.ply >= 2 && top > 0) {
+                if(largest.size() < top) {
+                    largest.push_back(r);
+                    std::push_heap(largest.begin(), largest.end(), larger);
+                } else if(r.nodes > largest.front().nodes) {
+                    std::pop_heap(largest.begin(), largest.end(), larger);
+                    largest.back() = r;
+                    std::push_heap(largest.begin(), largest.end(), larger);
+                }
+            }
+        }
+    }
+
+    std::cout << total << " records from " << threads << " thread(s), plies below " << header.full_plies << " complete, deeper ones 1 in "
+              << header.sample_rate << "\n";
+
+    // Deeper plies are sampled, their record counts are scaled back up to estimate the visited nodes
+    std::cout << "\nBy ply\n" << std::setw(4) << "ply" << std::setw(14) << "nodes" << std::setw(12) << "avg tree" << std::setw(12) << "max tree";
+    for(const char* name : reason_names)
+        std::cout << std::setw(7) << name;
+    std::cout << "\n";
+    for(size_t ply = 0; ply < plies.size(); ++ply) {
+        const struct ply_summary& p = plies[ply];
+        if(p.records == 0)
+            continue;
+        const uint64_t weight = ply < header.full_plies ? 1 : header.sample_rate;
+        std::cout << std::setw(4) << ply << std::setw(14) << p.records * weight << std::setw(12) << std::fixed << std::setprecision(1)
+                  << (double)p.nodes / p.records << std::setw(12) << p.max_nodes;
+        for(int reason = 0; reason < TRACE_REASONS; ++reason)
+            std::cout << std::setw(6) << std::setprecision(1) << 100.0 * p.reasons[reason] / p.records << "%";
+        std::cout << "\n";
+    }
+
+    if(!roots.empty()) {
+        std::vector<std::pair<movegen::move, struct root_summary>> sorted(roots.begin(), roots.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.nodes > b.second.nodes; });
+        uint64_t root_nodes = 0;
+        for(const auto& root : sorted)
+            root_nodes += root.second.nodes;
+        std::cout << "\nBy root move\n" << std::setw(8) << "move" << std::setw(10) << "searches" << std::setw(14) << "nodes"
+                  << std::setw(8) << "share" << std::setw(7) << "depth" << std::setw(8) << "score\n";
+        for(const auto& root : sorted) {
+            std::cout << std::setw(8) << move_to_str(root.first) << std::setw(10) << root.second.searches << std::setw(14) << root.second.nodes
+                      << std::setw(7) << std::setprecision(1) << 100.0 * root.second.nodes / std::max<uint64_t>(root_nodes, 1) << "%"
+                      << std::setw(7) << root.second.depth + 1 << std::setw(8) << root.second.score << "\n";
+        }
+    }
+
+    if(!largest.empty()) {
+        std::sort(largest.begin(), largest.end(), larger);
+        std::cout << "\nLargest subtrees below the root moves\n" << std::setw(8) << "root" << std::setw(8) << "move" << std::setw(5) << "ply"
+                  << std::setw(7) << "depth" << std::setw(22) << "window" << std::setw(8) << "score" << std::setw(12) << "nodes"
+                  << std::setw(7) << "how" << std::setw(8) << "thread\n";
+        for(const struct engine::trace::record& r : largest) {
+            std::cout << std::setw(8) << move_to_str(r.root_move) << std::setw(8) << move_to_str(r.move) << std::setw(5) << (int)r.ply
+                      << std::setw(7) << (int)r.depth << std::setw(22) << "[" + bound_to_str(r.alpha) + ", " + bound_to_str(r.beta) + "]"
+                      << std::setw(8) << r.score << std::setw(12) << r.nodes << std::setw(7) << reason_names[std::min<int>(r.reason, TRACE_REASONS - 1)]
+                      << std::setw(7) << (int)r.thread << "\n";
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+// Texel-style tuner for the evaluation parameters (see eval::params). Every labeled position is reduced once
+// to the coefficients of the parameters, after which the evaluation is a dot product. The parameters are then
+// fitted so that sigmoid(eval) predicts the game results, with the gradient summed over all cores.
+//
+// Usage: tune FILE [--threads N] [--epochs N] [--rate R] [--params FILE] [--out FILE] [--skip N]
+// FILE is a PGN file (every quiet position of a finished game is labeled with its result) or a text file
+// with one position per line: a FEN followed by the result as 1-0, 0-1, 1/2-1/2 or 1.0, 0.5, 0.0.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <math.h>
+#include "../src/eval.h"
+#include "../src/pgn.h"
+
+using namespace NerdChess;
+
+// 2 bytes per parameter and the result
+struct sample {
+    int16_t features[eval::PARAM_COUNT];
+    int8_t result; // 0 black won, 1 draw, 2 white won
+};
+
+static std::vector<struct sample> samples;
+static std::mutex samples_mutex;
+static int threads = 1;
+
+static bool make_sample(const struct board::position& pos, int result, struct sample& s) {
+    int features[eval::PARAM_COUNT];
+    eval::eval_features(pos, features);
+    for(int i = 0; i < eval::PARAM_COUNT; ++i) {
+        if(features[i] < INT16_MIN || features[i] > INT16_MAX)
+            return false;
+        s.features[i] = features[i];
+    }
+    s.result = result + 1;
+    return true;
+}
+
+static void load_pgn(const std::string& path, int skip) {
+    const struct pgn::read_stats stats = pgn::read_file(path, threads, [skip](const struct pgn::game& g) {
+        if(g.result == RESULT_UNKNOWN)
+            return;
+        std::vector<struct sample> game_samples;
+        struct board::position pos = g.start;
+        bool side = g.start_side;
+        for(size_t i = 0; i < g.moves.size(); ++i) {
+            // Only quiet positions, the evaluation can't see what a capture or check is about to change
+            const bool quiet = !movegen::in_check(pos, side) && !movegen::is_capture(pos, g.moves[i]);
+            struct sample s;
+            if((int)i >= skip && quiet && make_sample(pos, g.result, s))
+                game_samples.push_back(s);
+            movegen::make_move(pos, g.moves[i]);
+            side = !side;
+        }
+        std::lock_guard<std::mutex> lock(samples_mutex);
+        samples.insert(samples.end(), game_samples.begin(), game_samples.end());
+    });
+    std::cout << "Read " << stats.games << " games in " << stats.seconds << " s\n";
+}
+
+static void load_positions(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    while(std::getline(file, line)) {
+        int result;
+        if(line.find("1-0") != std::string::npos || line.find("1.0") != std::string::npos)
+            result = RESULT_WHITE_WIN;
+        else if(line.find("0-1") != std::string::npos || line.find("0.0") != std::string::npos)
+            result = RESULT_BLACK_WIN;
+        else if(line.find("1/2") != std::string::npos || line.find("0.5") != std::string::npos)
+            result = RESULT_DRAW;
+        else
+            continue;
+        struct board::position pos;
+        bool side;
+        struct sample s;
+        if(board::load_fen(pos, line, side) && make_sample(pos, result, s))
+            samples.push_back(s);
+    }
+}
+
+static inline double sigmoid(double eval, double k) {
+    return 1.0 / (1.0 + exp(-k * eval * M_LN10 / 400.0));
+}
+
+static inline double evaluate(const struct sample& s, const double weights[]) {
+    double eval = 0.0;
+    for(int i = 0; i < eval::PARAM_COUNT; ++i)
+        eval += s.features[i] * weights[i] / eval::param_divisors[i];
+    return eval;
+}
+
+// Mean squared error over all samples, and its gradient if gradient is not nullptr. Every thread sums a slice.
+static double error(const double weights[], double k, double gradient[]) {
+    std::vector<double> errors(threads, 0.0);
+    std::vector<std::vector<double>> gradients(threads, std::vector<double>(eval::PARAM_COUNT, 0.0));
+    std::vector<std::thread> pool;
+    for(int t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            const size_t begin = samples.size() * t / threads;
+            const size_t end = samples.size() * (t + 1) / threads;
+            double sum = 0.0;
+            std::vector<double>& grad = gradients[t];
+            for(size_t i = begin; i < end; ++i) {
+                const struct sample& s = samples[i];
+                const double predicted = sigmoid(evaluate(s, weights), k);
+                const double diff = s.result * 0.5 - predicted;
+                sum += diff * diff;
+                if(gradient) {
+                    const double d = -2.0 * diff * predicted * (1.0 - predicted) * k * M_LN10 / 400.0;
+                    for(int j = 0; j < eval::PARAM_COUNT; ++j)
+                        grad[j] += d * s.features[j] / eval::param_divisors[j];
+                }
+            }
+            errors[t] = sum;
+        });
+    }
+    for(std::thread& thread : pool)
+        thread.join();
+
+    double total = 0.0;
+    for(int t = 0; t < threads; ++t)
+        total += errors[t];
+    if(gradient) {
+        for(int j = 0; j < eval::PARAM_COUNT; ++j) {
+            gradient[j] = 0.0;
+            for(int t = 0; t < threads; ++t)
+                gradient[j] += gradients[t][j];
+            gradient[j] /= samples.size();
+        }
+    }
+    return total / samples.size();
+}
+
+// The scaling constant which fits the starting parameters best (ternary search, the error is convex in k)
+static double fit_k(const double weights[]) {
+    double low = 0.05, high = 5.0;
+    for(int i = 0; i < 40; ++i) {
+        const double a = low + (high - low) / 3.0;
+        const double b = high - (high - low) / 3.0;
+        if(error(weights, a, nullptr) < error(weights, b, nullptr))
+            high = b;
+        else
+            low = a;
+    }
+    return (low + high) / 2.0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string path, params_in, params_out = "params.txt";
+    int epochs = 1000, skip = 8;
+    double rate = 1.0;
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if(arg[0] != '-' && path.empty()) {
+            path = arg;
+            continue;
+        }
+        if(value.empty()) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        ++i;
+        if(arg == "--threads") threads = std::max(1, atoi(value.c_str()));
+        else if(arg == "--epochs") epochs = atoi(value.c_str());
+        else if(arg == "--rate") rate = atof(value.c_str());
+        else if(arg == "--params") params_in = value;
+        else if(arg == "--out") params_out = value;
+        else if(arg == "--skip") skip = atoi(value.c_str());
+        else {
+            std::cerr << "Invalid argument " << arg << " " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(path.empty()) {
+        std::cerr << "Usage: tune FILE [--threads N] [--epochs N] [--rate R] [--params FILE] [--out FILE] [--skip N]\n";
+        return EXIT_FAILURE;
+    }
+
+    generate_board_control_value_map(board_control_value_map_w, WHITE);
+    generate_board_control_value_map(board_control_value_map_b, BLACK);
+    movegen::init();
+    if(!params_in.empty() && !eval::load_params(params_in)) {
+        std::cerr << "Could not load " << params_in << "\n";
+        return EXIT_FAILURE;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if(path.size() > 4 && path.substr(path.size() - 4) == ".pgn")
+        load_pgn(path, skip);
+    else
+        load_positions(path);
+    if(samples.empty()) {
+        std::cerr << "No labeled positions in " << path << "\n";
+        return EXIT_FAILURE;
+    }
+    std::cout << samples.size() << " positions (" << samples.size() * sizeof(struct sample) / (1024 * 1024) << " MB)\n";
+
+    double weights[eval::PARAM_COUNT];
+    for(int i = 0; i < eval::PARAM_COUNT; ++i)
+        weights[i] = eval::params[i];
+    const double k = fit_k(weights);
+    std::cout << "K = " << k << ", error " << error(weights, k, nullptr) << "\n";
+
+    // Adam, the step size is in the units of each parameter
+    double m[eval::PARAM_COUNT] = {0}, v[eval::PARAM_COUNT] = {0}, gradient[eval::PARAM_COUNT];
+    const double beta1 = 0.9, beta2 = 0.999;
+    for(int epoch = 1; epoch <= epochs; ++epoch) {
+        const double e = error(weights, k, gradient);
+        for(int i = 0; i < eval::PARAM_COUNT; ++i) {
+            m[i] = beta1 * m[i] + (1.0 - beta1) * gradient[i];
+            v[i] = beta2 * v[i] + (1.0 - beta2) * gradient[i] * gradient[i];
+            const double m_hat = m[i] / (1.0 - pow(beta1, epoch));
+            const double v_hat = v[i] / (1.0 - pow(beta2, epoch));
+            weights[i] -= rate * m_hat / (sqrt(v_hat) + 1e-12);
+        }
+        if(epoch % 50 == 0 || epoch == epochs)
+            std::cout << "Epoch " << epoch << ": error " << e << "\n";
+    }
+
+    for(int i = 0; i < eval::PARAM_COUNT; ++i) {
+        eval::params[i] = (int)lround(weights[i]);
+        std::cout << eval::param_names[i] << " " << eval::params[i] << "\n";
+    }
+    eval::save_params(params_out);
+    std::cout << "Saved to " << params_out << " after "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+    return EXIT_SUCCESS;
+}